@@ -0,0 +1,69 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nl = nlohmann;
+
+namespace xtypes
+{
+    /** Compact binary encoding of the records produced by XType::export_to().
+     * Every record is encoded with MessagePack. Uris, classnames and relation names are stored once in a string table
+     * and the records refer to them by index. Fields which can be derived from the class definitions (uuid, delete_policy and relation_dir_forward) are left out.
+     *
+     * Layout (all integers little endian):
+     *   magic "XTYPESB" + version byte
+     *   for every record: uint32 size + [uri, classname, properties, [[relation, [[target, edge_properties], ...]], ...]]
+     *   uint32 size + [strings...]
+     *   uint64 offset of the string table + uint64 number of records */
+    class BinaryGraphWriter
+    {
+    public:
+        BinaryGraphWriter();
+
+        /// Encodes a record in the layout of export_to()
+        void add(const nl::json& record);
+
+        /// Returns the number of added records
+        std::size_t size() const { return this->n_records; }
+
+        /// Appends the string table and returns the encoded document. The writer cannot be used afterwards
+        std::vector< std::uint8_t > finish();
+
+    private:
+        /// Returns the index of a string in the string table
+        std::size_t index_of(const std::string& s);
+        /// Appends a size prefixed MessagePack value
+        void append(const nl::json& value);
+
+        std::unordered_map< std::string, std::size_t > indices;
+        std::vector< std::string > strings;
+        std::vector< std::uint8_t > data;
+        std::size_t n_records = 0;
+    };
+
+    /// Decodes a document written by BinaryGraphWriter
+    /// NOTE: The data has to outlive the reader
+    class BinaryGraphReader
+    {
+    public:
+        /// Reads the string table and locates the records. Throws std::runtime_error if it is not a valid document
+        explicit BinaryGraphReader(const std::vector< std::uint8_t >& data);
+
+        /// Returns the number of records
+        std::size_t size() const { return this->offsets.size(); }
+
+        /// Decodes a record in the layout of export_to() (without the derived fields)
+        nl::json at(const std::size_t index) const;
+
+    private:
+        const std::string& string_at(const nl::json& index) const;
+
+        const std::vector< std::uint8_t >& data;
+        std::vector< std::string > strings;
+        std::vector< std::size_t > offsets;
+    };
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+namespace xtypes
+{
+    /** Holds a value which is shared by all copies until one of them is modified.
+     * Copying is therefore O(1) and only the first modification of a shared value copies it (see mutate()).
+     * NOTE: Like the XTypes themselves this is not synchronized. Several threads may read a shared value,
+     * but a single CopyOnWrite must not be copied and modified at the same time */
+    template< typename T >
+    class CopyOnWrite
+    {
+    public:
+        CopyOnWrite() : value(std::make_shared< T >()) {}
+        CopyOnWrite(T initial) : value(std::make_shared< T >(std::move(initial))) {}
+
+        const T& operator*() const { return *this->value; }
+        const T* operator->() const { return this->value.get(); }
+
+        /// Returns the value for modification. It is copied first if it is shared with others
+        /// NOTE: References and pointers into the shared value do not refer to the own value afterwards
+        T& mutate()
+        {
+            if (this->is_shared())
+            {
+                this->value = std::make_shared< T >(*this->value);
+            }
+            return *this->value;
+        }
+
+        /// Returns true if other copies refer to the same value
+        bool is_shared() const { return this->value.use_count() > 1; }
+
+        /// Returns true if both refer to the same value
+        bool shares_with(const CopyOnWrite& other) const { return this->value == other.value; }
+
+    private:
+        std::shared_ptr< T > value;
+    };
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "enums.hpp"
+
+/** The hash functions behind uri_to_uuid().
+ * All of them are table driven CRCs which process 8 bytes per step (slicing-by-8), so they give the same values on every platform.
+ * CRC32C uses the SSE4.2 crc32 instruction instead if the CPU supports it. */
+namespace xtypes
+{
+    namespace hashing
+    {
+        /// CRC-32 (ISO-HDLC). Same values as CRC::Calculate(data, size, CRC::CRC_32()) and zlib.crc32()
+        std::uint32_t crc32(const void* data, const std::size_t size);
+        /// CRC-32C (Castagnoli)
+        std::uint32_t crc32c(const void* data, const std::size_t size);
+        /// CRC-64/XZ
+        std::uint64_t crc64(const void* data, const std::size_t size);
+
+        /// Returns true if crc32c() uses the SSE4.2 instruction
+        bool has_hardware_crc32c();
+
+        /// Hashes data with the given scheme
+        std::uint64_t hash(const void* data, const std::size_t size, const UuidScheme scheme);
+    }
+
+    /// Returns the scheme uri_to_uuid() uses (UuidScheme::CRC32 by default)
+    UuidScheme get_uuid_scheme();
+    /** Selects the scheme uri_to_uuid() uses in this process.
+     * NOTE: This has to happen before any instance is created. The uris built from relations contain the uuids of the targets,
+     * so instances created with different schemes do not match. Data written with one scheme has to be read with the same scheme */
+    void set_uuid_scheme(const UuidScheme scheme);
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+namespace nl = nlohmann;
+
+/** Optional counters and latency histograms of the hot paths of XType and XTypeRegistry.
+ * They are only compiled in if XTYPES_INSTRUMENTATION is defined (CMake option XTYPES_INSTRUMENTATION).
+ * Otherwise the XTYPES_COUNT()/XTYPES_TIME() macros expand to nothing and the query functions report nothing.
+ *
+ * Every thread counts into its own block of relaxed atomics, so counting never contends with other threads.
+ * Only the owning thread writes a block, while snapshot() sums up the blocks of all threads.
+ * The blocks of finished threads are kept (and reused by new threads), so nothing counted gets lost. */
+namespace xtypes
+{
+    namespace instrumentation
+    {
+        enum class Counter : std::size_t
+        {
+            URI_CACHE_HITS,     ///< uri() returned the cached uri
+            URI_BUILDS,         ///< uri() had to call build_uri()
+            LOAD_HITS,          ///< load_by_uri()/load_many() found an uri in the registry
+            LOAD_MISSES,        ///< load_by_uri()/load_many() had to ask the load function for an uri
+            LOAD_FAILURES,      ///< ... and the load function did not return an instance
+            COMMITS,            ///< Instances committed by commit()/commit_many()
+            COMMIT_COPIES,      ///< Copies of committed instances into the valid or temporary instances
+            CHECKOUT_COPIES,    ///< Temporary copies of valid instances created by get_by_uri()
+            INVERSE_FILLS,      ///< Inverse facts auto-filled by add_fact()
+            INVERSE_FALLBACKS,  ///< Inverse relation lookups which could not use the table of the registry
+            N_COUNTERS
+        };
+        static const char* Counter2Str[] = {
+            "URI_CACHE_HITS",
+            "URI_BUILDS",
+            "LOAD_HITS",
+            "LOAD_MISSES",
+            "LOAD_FAILURES",
+            "COMMITS",
+            "COMMIT_COPIES",
+            "CHECKOUT_COPIES",
+            "INVERSE_FILLS",
+            "INVERSE_FALLBACKS"
+        };
+
+        enum class Timer : std::size_t
+        {
+            BUILD_URI,  ///< build_uri() calls of uri()
+            LOAD_FUNC,  ///< Calls of the load functions by load_by_uri()/load_many()
+            COMMIT,     ///< commit() and commit_many() calls
+            N_TIMERS
+        };
+        static const char* Timer2Str[] = {
+            "BUILD_URI",
+            "LOAD_FUNC",
+            "COMMIT"
+        };
+
+        /// Bucket i of a histogram counts the durations in [2^i, 2^(i+1)) ns (bucket 0 includes 0 ns, the last one everything above)
+        static constexpr std::size_t n_buckets = 40;
+
+        struct Histogram
+        {
+            std::uint64_t count = 0;
+            std::uint64_t total_ns = 0;
+            std::array< std::uint64_t, n_buckets > buckets{};
+
+            /// Returns the upper bound (in ns) of the bucket which contains the given quantile (0..1)
+            std::uint64_t quantile_ns(const double quantile) const;
+            nl::json to_json() const;
+        };
+
+        /// Returns true if the library has been compiled with XTYPES_INSTRUMENTATION
+        bool enabled();
+        /// Returns the sum of a counter over all threads
+        std::uint64_t count(const Counter counter);
+        /// Returns the sum of a histogram over all threads
+        Histogram histogram(const Timer timer);
+        /// Returns all counters and histograms as {"enabled": ..., "counters": {...}, "timers": {...}}
+        nl::json snapshot();
+        /// Sets all counters and histograms to zero
+        /// NOTE: Counts of other threads which are in progress during the reset might survive it
+        void reset();
+    }
+}
+
+#ifdef XTYPES_INSTRUMENTATION
+namespace xtypes
+{
+    namespace instrumentation
+    {
+        namespace detail
+        {
+            struct Block
+            {
+                std::array< std::atomic< std::uint64_t >, static_cast< std::size_t >(Counter::N_COUNTERS) > counters{};
+                std::array< std::atomic< std::uint64_t >, static_cast< std::size_t >(Timer::N_TIMERS) > total_ns{};
+                std::array< std::array< std::atomic< std::uint64_t >, n_buckets >, static_cast< std::size_t >(Timer::N_TIMERS) > buckets{};
+            };
+
+            /// Assigns a block to the calling thread (see thread_block())
+            Block& acquire_block();
+
+            /// Returns the block of the calling thread
+            inline Block& thread_block()
+            {
+                static thread_local Block* block = nullptr;
+                if (!block)
+                    block = &acquire_block();
+                return *block;
+            }
+
+            /// Only the owning thread writes a value, so we do not need an atomic read-modify-write
+            inline void increment(std::atomic< std::uint64_t >& value, const std::uint64_t n)
+            {
+                value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            }
+        }
+
+        inline void add(const Counter counter, const std::uint64_t n = 1)
+        {
+            detail::increment(detail::thread_block().counters[static_cast< std::size_t >(counter)], n);
+        }
+
+        inline void record(const Timer timer, const std::uint64_t ns)
+        {
+            std::size_t bucket = 0;
+            for (std::uint64_t rest = ns >> 1; (rest > 0) && (bucket + 1 < n_buckets); rest >>= 1)
+                bucket++;
+            detail::Block& block(detail::thread_block());
+            detail::increment(block.total_ns[static_cast< std::size_t >(timer)], ns);
+            detail::increment(block.buckets[static_cast< std::size_t >(timer)][bucket], 1);
+        }
+
+        /// Records the lifetime of the timer
+        class ScopedTimer
+        {
+        public:
+            explicit ScopedTimer(const Timer timer) : timer(timer), start(std::chrono::steady_clock::now()) {}
+            ~ScopedTimer()
+            {
+                record(this->timer, std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now() - this->start).count());
+            }
+
+        private:
+            const Timer timer;
+            const std::chrono::steady_clock::time_point start;
+        };
+    }
+}
+
+/// Adds n to the given Counter
+#define XTYPES_COUNT_N(counter, n) ::xtypes::instrumentation::add(::xtypes::instrumentation::Counter::counter, (n))
+/// Adds one to the given Counter
+#define XTYPES_COUNT(counter) XTYPES_COUNT_N(counter, 1)
+/// Records the time until the end of the enclosing scope with the given Timer
+#define XTYPES_TIME(timer) const ::xtypes::instrumentation::ScopedTimer xtypes_scoped_timer_##timer(::xtypes::instrumentation::Timer::timer)
+#else
+#define XTYPES_COUNT_N(counter, n) ((void)0)
+#define XTYPES_COUNT(counter) ((void)0)
+#define XTYPES_TIME(timer) ((void)0)
+#endif
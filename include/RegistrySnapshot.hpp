@@ -0,0 +1,75 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nl = nlohmann;
+
+namespace xtypes
+{
+    /** Read-only snapshot of the valid instances of a registry which is memory mapped from a file.
+     * Opening a snapshot only maps the file, records are decoded when they are looked up.
+     * Several processes can map the same file and share its pages.
+     *
+     * Layout (all integers little endian):
+     *   magic "XTSNAP" + version byte + padding byte
+     *   for every record: uint32 uri size + uri + uint32 size + MessagePack of {uri, classname, properties, relations: {name: [{target, edge_properties}, ...]}}
+     *   hash index: n_buckets x (uint64 uri_to_uuid(uri, UuidScheme::CRC32), uint64 record offset + 1 (0 marks an empty bucket))
+     *   uint64 offset of the index + uint64 number of buckets + uint64 number of records
+     * NOTE: We use uri_to_uuid() for the index, because the file has to be readable on other platforms as well.
+     * The index always uses the CRC32 scheme, so it does not depend on set_uuid_scheme() */
+    class RegistrySnapshot
+    {
+    public:
+        /// Maps a snapshot file. Throws std::runtime_error if the file is not a valid snapshot
+        explicit RegistrySnapshot(const std::string& path);
+        ~RegistrySnapshot();
+
+        RegistrySnapshot(const RegistrySnapshot&) = delete;
+        RegistrySnapshot& operator=(const RegistrySnapshot&) = delete;
+
+        /// Returns the number of records
+        std::size_t size() const { return this->n_records; }
+
+        /// Returns true if the snapshot has a record for the uri
+        bool contains(const std::string& uri) const;
+
+        /// Returns the record of an uri in the layout of XType::export_record() (without the derived fields) or null if unknown
+        nl::json find(const std::string& uri) const;
+
+        /// Writes snapshot files record by record
+        class Writer
+        {
+        public:
+            /// Creates (or truncates) the file. Throws std::runtime_error on failure
+            explicit Writer(const std::string& path);
+
+            /// Appends a record in the layout of XType::export_record()
+            void add(const nl::json& record);
+
+            /// Appends the index. The writer cannot be used afterwards
+            void finish();
+
+        private:
+            std::ofstream file;
+            std::uint64_t offset = 0;
+            /// uri_to_uuid(uri, UuidScheme::CRC32) and offset of every record
+            std::vector< std::pair< std::uint64_t, std::uint64_t > > entries;
+        };
+
+    private:
+        /// Returns the offset of the record of an uri or 0 if unknown
+        std::uint64_t locate(const std::string& uri) const;
+        std::uint64_t read_uint(const std::uint64_t offset, const std::size_t n_bytes) const;
+
+        const std::uint8_t* data = nullptr;
+        std::size_t data_size = 0;
+        std::uint64_t index_offset = 0;
+        std::uint64_t n_buckets = 0;
+        std::uint64_t n_records = 0;
+    };
+}
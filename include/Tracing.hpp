@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/** Optional tracing of graph traversals, loads, imports and commits.
+ * Like the counters of Instrumentation.hpp the spans are only compiled in if XTYPES_INSTRUMENTATION is defined.
+ * Then they are recorded between start() and stop() and written as Chrome trace JSON (viewable with chrome://tracing or Perfetto).
+ * Every span carries the uri, classname and relation name it concerns (if any) and nested spans of a thread show which call caused which.
+ * NOTE: While no trace is running, a span costs a single relaxed atomic load */
+namespace xtypes
+{
+    class XType;
+
+    namespace tracing
+    {
+        /// Starts recording spans which are written to the given file by stop()
+        /// Throws if a trace is already running or the library has been compiled without XTYPES_INSTRUMENTATION
+        void start(const std::string& path);
+        /// Stops recording and writes the trace file. Returns the number of recorded spans
+        std::size_t stop();
+        /// Returns true while a trace is running
+        bool is_running();
+    }
+}
+
+#ifdef XTYPES_INSTRUMENTATION
+namespace xtypes
+{
+    namespace tracing
+    {
+        namespace detail
+        {
+            extern std::atomic< bool > running;
+        }
+
+        /// Records the time between its construction and destruction as a span (if a trace is running)
+        class Span
+        {
+        public:
+            explicit Span(const char* name)
+            : name(name), active(detail::running.load(std::memory_order_relaxed))
+            {
+                if (this->active)
+                    this->start = std::chrono::steady_clock::now();
+            }
+            ~Span();
+
+            bool is_active() const { return this->active; }
+
+            /// Sets the uri and classname of the span from an XType (whose uri might not be buildable)
+            void set(const XType& xtype, const std::string& relation = "");
+            void set(const std::string& uri, const std::string& classname = "", const std::string& relation = "");
+
+        private:
+            const char* name;
+            const bool active;
+            std::chrono::steady_clock::time_point start;
+            std::string uri;
+            std::string classname;
+            std::string relation;
+        };
+    }
+}
+
+/// Records the enclosing scope as a span. The arguments are passed to Span::set() and only evaluated if a trace is running
+#define XTYPES_TRACE(name, ...) \
+    ::xtypes::tracing::Span xtypes_trace_span(name); \
+    if (xtypes_trace_span.is_active()) xtypes_trace_span.set(__VA_ARGS__)
+#else
+#define XTYPES_TRACE(name, ...) ((void)0)
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace xtypes
+{
+    /// Compact handle of an uri which has been interned into an UriTable
+    using UriHandle = std::uint32_t;
+
+    /** Interning table for uris.
+     * Every uri is stored only once and gets a dense handle (0, 1, 2, ...) which can be used to index further tables.
+     * The handles of erased uris are reused by the next interned ones, so the handles stay dense.
+     * The lookup uses an open addressing hash table. Erased entries leave tombstones which are dropped on the next rehash.
+     * NOTE: We use std::hash here and not uri_to_uuid(), because the table does not need platform independent values and std::hash is faster */
+    class UriTable
+    {
+    public:
+        /// Returned by find() if an uri has not been interned
+        static constexpr UriHandle npos = static_cast<UriHandle>(-1);
+
+        /// Returns the handle of an uri or npos if it is unknown
+        UriHandle find(const std::string& uri) const;
+        /// Same as above with an already computed std::hash of the uri
+        UriHandle find(const std::string& uri, const std::size_t hash) const;
+
+        /// Returns the handle of an uri. The uri is interned if it is unknown
+        UriHandle intern(const std::string& uri);
+        /// Same as above with an already computed std::hash of the uri
+        UriHandle intern(const std::string& uri, const std::size_t hash);
+
+        /// Forgets an uri. Its handle will be reused by another uri. Returns false if the uri is unknown
+        bool erase(const std::string& uri);
+        /// Same as above with an already computed std::hash of the uri
+        bool erase(const std::string& uri, const std::size_t hash);
+
+        /// Returns the uri of a handle (empty if it has been erased)
+        const std::string& at(const UriHandle handle) const { return this->uris.at(handle); }
+
+        /// Returns the number of interned uris
+        std::size_t size() const { return this->uris.size() - this->free_handles.size(); }
+        /// Returns the number of handles in use or free (all handles are below it)
+        std::size_t capacity() const { return this->uris.size(); }
+
+        /// Forgets all uris. Existing handles become invalid
+        void clear();
+
+    private:
+        /// Marks a bucket of an erased handle
+        static constexpr UriHandle tombstone = npos - 1;
+
+        /// Returns the bucket which holds the handle of uri or the number of buckets if it is unknown
+        std::size_t find_bucket(const std::string& uri, const std::size_t hash) const;
+        void rehash(const std::size_t n_buckets);
+
+        /// NOTE: A deque keeps references to the uris valid while growing
+        std::deque< std::string > uris;
+        std::vector< std::size_t > hashes;
+        /// Open addressing hash table of handles (npos marks an empty bucket)
+        std::vector< UriHandle > buckets;
+        /// Number of buckets which are not empty (including tombstones)
+        std::size_t used_buckets = 0;
+        /// Handles of erased uris
+        std::vector< UriHandle > free_handles;
+    };
+}
@@ -3,12 +3,17 @@
 #include <nlohmann/json.hpp>
 #include <functional>
 #include <stdexcept>
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <string>
 #include <map>
 #include <set>
 #include <deque>
+#include <future>
+#include <mutex>
+#include <istream>
+#include <ostream>
 
 #include "enums.hpp"
 #include "structs.hpp"
@@ -19,6 +24,7 @@ namespace xtypes {
     /*Forward declarations*/
     class XType;
     class XTypeRegistry;
+    class BinaryGraphReader;
 
     /* Some good aliases */
     using XTypePtr = std::shared_ptr< XType >;
@@ -26,6 +32,18 @@ namespace xtypes {
     using ConstXTypePtr = std::shared_ptr< const XType >;
     using ConstXTypeCPtr = const std::shared_ptr< const XType >;
 
+    /// Progress of a bulk import (see XType::import_from_stream())
+    struct ImportStats
+    {
+        std::size_t n_imported = 0; /* < number of committed XTypes */
+        std::size_t n_skipped = 0;  /* < number of empty records */
+        std::streamoff offset = 0;  /* < byte offset up to which everything has been committed. Pass it to resume an import */
+        double seconds = 0.0;       /* < time spent so far */
+
+        /// Returns the import throughput in nodes per second
+        double nodes_per_second() const { return (seconds > 0.0) ? n_imported / seconds : 0.0; }
+    };
+
     /** Base class for all XType specializations.
      * XTypes are an object oriented type definition which like a normal class hold properties and can have member functions;
      * but further more they can hold relations to other XTypes. */
@@ -39,9 +57,13 @@ namespace xtypes {
 
         /** This function returns the classname reported back from derived classes.
          * Useful for lookup from base class to derived class. */
-        std::string get_classname() const noexcept;
+        const std::string& get_classname() const noexcept;
+
+        /// Returns the interned classname (see intern_name()), e.g. for cheap comparisons of classes
+        NameId get_classname_id() const noexcept;
 
-        /// This method is modified by each derived type (see xtypes_generator)
+        /** Returns the uri of this XType.
+         * The uri is cached and only rebuilt (see build_uri()) if a property or relation it depends on has changed. */
         virtual std::string uri() const;
 
         /// This method checks if the uri can be build
@@ -58,6 +80,19 @@ namespace xtypes {
         /// This method has to always return an up-to-date hash of the current uri
         std::size_t uuid() const;
 
+        /** Returns a number which changes whenever the uri of this XType has changed.
+         * XTypes whose uri is built from the uri of others use this to detect outdated caches.
+         * Returns 0 if the uri is currently invalid. */
+        std::uint64_t uri_revision() const;
+
+        /// Returns a counter which increases whenever an uri which has already been built might have changed (see FactList)
+        static std::uint64_t uri_epoch();
+
+        /** Appends the XTypes whose uri might have changed since epoch (a value of uri_epoch()) to changed and advances epoch past them.
+         * nullptr stands for an XType which is not known. Only the most recent changes are kept, so this returns false if epoch is too old.
+         * NOTE: Epoch stays before changes which are still being logged by other threads, so it might be less than uri_epoch() afterwards */
+        static bool uri_changes_since(std::uint64_t& epoch, std::vector< const XType* >& changed);
+
         /// Sets the registry of the XType if not already set
         void set_registry_once(XTypeRegistryCPtr reg);
 
@@ -79,6 +114,38 @@ namespace xtypes {
          */
         std::map<std::string, nl::json> export_to(const int max_depth=-1);
 
+        /// Receives the uri and the serialization of every exported XType (see export_to_writer())
+        using ExportWriter = std::function< void(const std::string& uri, const nl::json& record) >;
+
+        /**
+         * Same as export_to() but every serialized XType is passed to a writer as soon as it has been visited
+         * NOTE: Only the uris of the visited XTypes are kept in memory, so use this for full exports of large models
+         * @param writer Function which receives the uri and the serialization of every exported XType
+         * @param max_depth Depth limit up to which dependent XTypes are resolved. -1 means no depth limit (full export)
+         * @returns The number of exported XTypes
+         */
+        std::size_t export_to_writer(const ExportWriter& writer, const int max_depth=-1);
+
+        /**
+         * Same as export_to_writer() but the serializations are written to a stream as JSON lines (one XType per line)
+         * @returns The number of exported XTypes
+         */
+        std::size_t export_to_stream(std::ostream& stream, const int max_depth=-1);
+
+        /**
+         * Same as export_to_writer() but the visited XTypes are serialized concurrently by several threads
+         * NOTE: The traversal (resolving facts and committing) stays in this thread and the writer is called from it in the same order as by export_to_writer()
+         * @param n_threads Number of threads which serialize. 0 means one per hardware thread
+         * @returns The number of exported XTypes
+         */
+        std::size_t export_to_writer_parallel(const ExportWriter& writer, const std::size_t n_threads, const int max_depth=-1);
+
+        /**
+         * Same as export_to_stream() but the XTypes are serialized and dumped concurrently (see export_to_writer_parallel())
+         * @returns The number of exported XTypes
+         */
+        std::size_t export_to_stream_parallel(std::ostream& stream, const std::size_t n_threads, const int max_depth=-1);
+
         /**
          * Imports an XType, its dependencies and properties from an JSON object
          * NOTE: This function is part of the basis for a json based XType database
@@ -89,6 +156,66 @@ namespace xtypes {
          */
         static XTypeCPtr import_from(const nl::json& spec, XTypeRegistryCPtr reg);
 
+        /**
+         * Same as export_to() but the records are encoded in the compact binary format of BinaryGraphWriter
+         * @param max_depth Depth limit up to which dependent XTypes are resolved. -1 means no depth limit (full export)
+         * @returns The encoded records
+         */
+        std::vector< std::uint8_t > export_binary(const int max_depth=-1);
+
+        /**
+         * Imports all XTypes of a document written by export_binary() into a registry
+         * @param data The encoded records
+         * @param reg The project registry to use to import the XTypes
+         * @returns The first XType of the document (the one export_binary() has been called on) or nullptr if empty
+         */
+        static XTypeCPtr import_binary(const std::vector< std::uint8_t >& data, XTypeRegistryCPtr reg);
+
+        /// Serializes only this XType in the layout of export_to(). Facts are exported by their target uri and nothing is resolved
+        nl::json export_record() const;
+
+        /* Change tracking */
+
+        /// Returns true if this XType has been modified since the last checkpoint (see clear_changes()). New XTypes are always modified
+        bool has_changes() const;
+
+        /// Returns the names of all relations whose facts have been modified since the last checkpoint
+        std::set< std::string > get_changed_relations() const;
+
+        /// Sets a checkpoint. Afterwards only further modifications are reported
+        void clear_changes();
+
+        /// Same as export_record() but only the relations with modified facts are exported (see XTypeRegistry::export_changes())
+        nl::json export_changes_record() const;
+
+        /// Receives the progress of import_from_stream() after every committed batch
+        using ImportProgress = std::function< void(const ImportStats& stats) >;
+
+        /**
+         * Imports all XTypes of a JSON lines stream (e.g. written by export_to_stream()) into a registry
+         * The records are parsed, instantiated and committed batch by batch, so only one batch is held in memory at a time
+         * NOTE: With the STRONG temporary policy the registry keeps every instantiated XType alive. Use WEAK or KEEP_NONE for large imports
+         * @param stream The stream to read the records from
+         * @param reg The project registry to import the XTypes into
+         * @param offset Byte offset to start reading at (e.g. the offset of the ImportStats of an interrupted import)
+         * @param progress Optional function which is called after every committed batch
+         * @param batch_size Number of records committed at once
+         * @param n_threads Number of threads which parse and instantiate the records of a batch. 0 means one per hardware thread
+         * @returns The final statistics of the import
+         */
+        static ImportStats import_from_stream(std::istream& stream, XTypeRegistryCPtr reg, const std::streamoff offset=0, const ImportProgress& progress={}, const std::size_t batch_size=1024, const std::size_t n_threads=1);
+
+        /**
+         * Imports many records (in the layout of export_record()) into a registry
+         * The XTypes are instantiated and validated by several threads concurrently and then committed in one step (see XTypeRegistry::commit_many())
+         * NOTE: If a record is invalid, the error of the first one is thrown and nothing is committed
+         * @param specs The records to import
+         * @param reg The project registry to import the XTypes into
+         * @param n_threads Number of threads which instantiate the XTypes. 0 means one per hardware thread
+         * @returns The statistics of the import (the offset is not used)
+         */
+        static ImportStats import_many(const std::vector< nl::json >& specs, XTypeRegistryCPtr reg, const std::size_t n_threads=0);
+
         /* Property Interface */
 
         /**
@@ -151,6 +278,20 @@ namespace xtypes {
          */
         void set_property(const std::string& path_to_key, const nl::json& new_value, const bool shall_throw = true);
 
+        /**
+         * Retrieve the current value of a property by a precompiled key (used by the generated getters)
+         * @param key The precompiled key
+         * @returns A reference to the current value which stays valid until the property gets changed
+         */
+        const nl::json& get_property_by_key(const PropertyKey& key) const;
+        /**
+         * Assign a new value to a property by a precompiled key (used by the generated setters)
+         * @param key The precompiled key
+         * @param new_value The new value
+         * @param (optional) shall_throw If true the function will throw on invalid assignments
+         */
+        void set_property_by_key(const PropertyKey& key, const nl::json& new_value, const bool shall_throw = true);
+
         /**
          * Get all properties and their values
          * @returns The properties
@@ -193,10 +334,10 @@ namespace xtypes {
         bool has_relation(const std::string& name) const;
 
         /// Returns all the currently defined relations on the XType
-        std::map<std::string, Relation> get_relations() const;
+        const std::map<std::string, Relation>& get_relations() const;
 
         /// Get the relation definition for the given attribute name
-        Relation get_relation(const std::string& name) const;
+        const Relation& get_relation(const std::string& name) const;
 
         /// Get the direction in which the attribute gets filled with dependent XType(s)
         /// true if points forward, false otherwise
@@ -218,7 +359,15 @@ namespace xtypes {
         void set_all_unknown_facts_empty();
 
         /// Retrieve all the facts currently stored in the given named attribute
-        const std::vector< Fact > get_facts(const std::string& name);
+        /// The result holds the targets of the facts (see PinnedFacts)
+        const PinnedFacts get_facts(const std::string& name);
+
+        /// Same as get_facts(), but the loads of all unresolved targets are issued concurrently in the background
+        /// NOTE: The facts themselves are updated when get() is called on the future, so call it from the thread owning this XType
+        std::future< PinnedFacts > get_facts_async(const std::string& name);
+
+        /// Returns the target uris of all facts which have not been resolved yet
+        std::vector< std::string > get_unresolved_uris() const;
 
         /** Add a fact to the named relation
          *  @param The name of the relation
@@ -345,17 +494,52 @@ namespace xtypes {
         }
 
     protected:
+        /// This method builds the uri from scratch and is modified by each derived type (see xtypes_generator)
+        virtual std::string build_uri() const;
+
+        /// Returns the property keys the uri is built from (see uri.from section of the templates)
+        virtual const std::set<std::string>& get_uri_properties() const;
+
+        /// Returns the relation names whose facts the uri is built from (see uri.from section of the templates)
+        virtual const std::set<std::string>& get_uri_relations() const;
+
+        /** Marks the cached uri as outdated.
+         * NOTE: Derived types which modify properties or facts directly have to call this */
+        void invalidate_uri() const;
+
+        /** Replaces the definitions and properties of this XType by the ones shared by a previous instance of the same class (see share_class_schema()).
+         * NOTE: The generated constructors use this to define their properties and relations only once per class
+         * @param level The class whose constructor calls this (the classname of a derived class is in m_classname_id)
+         * @returns True if the definitions have been adopted, false if they still have to be defined */
+        bool adopt_class_schema(const std::string& level);
+
+        /// Shares the current definitions and properties with all further instances of the same class (see adopt_class_schema())
+        void share_class_schema(const std::string& level);
+
+        /// Has to be called whenever the value of a property has been changed
+        void property_changed(const std::string& path_to_key);
+
+        /// Has to be called whenever the facts of a relation have been changed
+        void facts_changed(const std::string& name);
+
+        /// Reports this XType as modified to its registry (only once until the changes have been exported)
+        void list_changes();
+
         /// Every XType gets a registry instance which has to be used when instantiating new XType(s) during runtime
         std::weak_ptr< XTypeRegistry > registry;
 
-        std::string m_classname;
+        /// The interned classname and the name it refers to (see intern_name())
+        NameId m_classname_id;
+        const std::string* m_classname;
 
-        std::map< std::string, Relation > relations;        /* < specifies which relation is attached to the corresponding entry in facts */
-        std::map< std::string, bool > relation_dir_forward; /* < specifies whether the target (forward direction) or the source of a relation is filled into the corresponding entry in facts */
-        std::map< std::string, std::vector< ExtendedFact > > facts; /* < Holds facts/references to other XTypes (either by URI or by weak pointer) */
+        std::shared_ptr< const ClassSchema > schema;        /* < Holds the property and relation definitions (shared with other instances of the same class, see adopt_class_schema()) */
+        /// Holds facts/references to other XTypes (either by URI or by weak pointer)
+        /// NOTE: Copies of an XType share them until one of them modifies them (use facts.mutate())
+        CopyOnWrite< std::map< std::string, FactList > > facts;
 
-        PropertySchema property_schema;
-        nl::json properties;
+        /// NOTE: Derived types must not restructure this object directly, because pointers to its values are cached (see property_slots)
+        /// Copies of an XType share them until one of them modifies them (see mutable_properties())
+        CopyOnWrite< nl::json > properties;
 
         /// Checks whether the passed pointer is an instance of the base class
         template<typename Base, typename T>
@@ -364,5 +548,108 @@ namespace xtypes {
            return dynamic_cast<const Base*>(ptr) != nullptr;
         }
 
+    private:
+        // NOTE: The registry uses commit_records() in XTypeRegistry::import_binary() and the schema to precompute inverse relations
+        friend class XTypeRegistry;
+        // NOTE: FactList checks get_uri_relations() of the targets to know which of their uris might change without notice
+        friend class FactList;
+
+        /// Instantiates an XType from a spec (see import_from()) without committing it
+        static XTypePtr build_from(const nl::json& spec, XTypeRegistryCPtr reg);
+
+        /// Instantiates and commits all records of a binary document. Returns the number of committed XTypes
+        static std::size_t commit_records(const BinaryGraphReader& reader, XTypeRegistryCPtr reg);
+
+        /// Returns the interned name of a level of adopt_class_schema() and share_class_schema()
+        NameId level_id(const std::string& level) const;
+
+        /// Encodes the record of an exported XType (called concurrently by the parallel exports)
+        using ExportEncoder = std::function< void(const nl::json& record, std::string& encoded) >;
+        /// Receives the uri, the record and its encoding of every exported XType in the order of the traversal
+        using ExportEmitter = std::function< void(const std::string& uri, const nl::json& record, const std::string& encoded) >;
+
+        /// Number of visited XTypes per thread which the parallel exports serialize at once
+        static constexpr std::size_t export_chunk_size = 64;
+
+        /// Implementation of the exports: Traverses the XTypes like export_to() and serializes (and encodes) chunks of them with n_threads threads
+        std::size_t export_chunked(const std::size_t n_threads, const std::size_t chunk_size, const int max_depth, const ExportEncoder& encode, const ExportEmitter& emit);
+
+        /// Returns the definitions of this XType for modification. They are copied first if they are shared with others
+        ClassSchema& mutable_schema();
+
+        /// Returns the properties for modification. They are copied first if they are shared with others
+        nl::json& mutable_properties();
+
+        /// Returns the slot of a fact of a relation which is equal to fact or FactList::npos
+        /// NOTE: Rebuilds the index of the facts first if it might be outdated (see FactList::is_index_current())
+        std::size_t find_fact(const std::string& name, const ExtendedFact& fact);
+
+        /// Adds this XType to the relations of other which match the relation name inversely
+        void add_inverse_facts(const std::string& name, XTypeCPtr& other, const nl::json& props);
+
+        /// Returns the value of the property in the given slot of the property schema
+        const nl::json& get_property_slot(const std::size_t slot) const;
+
+        /// Validates and assigns a new value to the property in the given slot of the property schema
+        void set_property_slot(const std::size_t slot, const nl::json& new_value, const bool shall_throw);
+
+        /// Pointers to the values in properties for every slot of the property schema (resolved on first access)
+        struct PropertySlotCache
+        {
+            PropertySlotCache() = default;
+            // NOTE: Copies are left empty, because the pointers refer to the properties of the original
+            PropertySlotCache(const PropertySlotCache&) {}
+            PropertySlotCache& operator=(const PropertySlotCache&) { values.clear(); return *this; }
+
+            std::vector< const nl::json* > values;
+        };
+        mutable PropertySlotCache property_slots;
+
+        /// Returns the current uri revisions of the fact targets the uri is built from (0 for a missing target, see get_uri_relations())
+        std::vector< std::uint64_t > current_target_revisions() const;
+
+        /// Holds the last uri built by build_uri() together with its uuid
+        /// NOTE: uri() fills the cache of const XTypes, which might be shared between threads (e.g. by XTypeRegistry::get_by_uri()), so it is guarded by its mutex
+        struct UriCache
+        {
+            UriCache() = default;
+            UriCache(const UriCache& other);
+            UriCache& operator=(const UriCache& other);
+
+            mutable std::mutex mutex;
+            /// The XType this cache belongs to (nullptr for a copy which has not been used yet)
+            const XType* owner = nullptr;
+            bool valid = false;
+            bool failed = false; /* < true if the last build_uri() has thrown */
+            std::string uri;
+            std::size_t uuid = 0;
+            std::uint64_t revision = 0;
+            /// Changes whenever the cache is invalidated or assigned, so uri() does not publish an uri built before that
+            std::uint64_t generation = 0;
+            /// The uri revisions of all fact targets at the time the uri has been built (0 if no target was available)
+            std::vector< std::uint64_t > target_revisions;
+        };
+        mutable UriCache uri_cache;
+
+        /// Modifications since the last checkpoint
+        struct ChangeSet
+        {
+            bool all = true; /* < everything is new (no checkpoint yet) */
+            bool properties = false;
+            std::set< std::string > relations;
+        };
+        ChangeSet changes;
+
+        /// True if this XType is in the list of modified XTypes of its registry
+        struct ChangeListing
+        {
+            ChangeListing() = default;
+            // NOTE: Copies are not listed, but the listing of an assigned XType stays as it is
+            ChangeListing(const ChangeListing&) {}
+            ChangeListing& operator=(const ChangeListing&) { return *this; }
+
+            bool listed = false;
+        };
+        ChangeListing change_listing;
     };
 }
@@ -9,14 +9,28 @@
  * NOTE: The registry returns SHARED pointers and not UNIQUE ones.
  * We do that to allow others to use the registry as a member or argument when they instantiate new XTypes.
  *
+ * NOTE: The registry itself can be used from multiple threads. The XTypes it hands out are NOT synchronized.
+ * The valid instances are distributed over shards which have their own reader/writer locks,
+ * so lookups run in parallel and commits of different uris only block each other if they hit the same shard.
+ *
  */
 
+#include <condition_variable>
 #include <functional>
+#include <future>
 #include <memory>
 #include <map>
+#include <unordered_map>
 #include <string>
 #include <vector>
 #include <set>
+#include <mutex>
+#include <shared_mutex>
+
+#include <nlohmann/json.hpp>
+
+#include "UriTable.hpp"
+#include "enums.hpp"
 
 /**
  * XType v3
@@ -29,6 +43,8 @@
 namespace xtypes
 {
     class XType;
+    class RegistrySnapshot;
+    struct ClassSchema;
 
     /* Some good aliases */
     using XTypePtr = std::shared_ptr< XType >;
@@ -38,14 +54,26 @@ namespace xtypes
     using UniqueXTypePtr = std::unique_ptr< XType >;
     using XTypeWeakPtr = std::weak_ptr< XType >;
 
+    /// Counters about the temporary instances of a registry (see XTypeRegistry::get_temporary_stats())
+    struct TemporaryStats
+    {
+        std::size_t created = 0;     /* < number of instances created by instantiate_from() */
+        std::size_t tracked = 0;     /* < number of instances currently tracked (might include expired ones if the policy is WEAK) */
+        std::size_t compactions = 0; /* < number of times the expired instances have been removed */
+        std::size_t reclaimed = 0;   /* < number of expired instances removed */
+    };
+
     /// Base Class for the Registries of the XTypes and for the Project Registries in the XTypes specializing projects
     struct XTypeRegistry : public std::enable_shared_from_this<XTypeRegistry>
     {
         /// Factory constructor
-        XTypeRegistry();
+        /// @param n_shards The number of shards of the valid instances. Use more than one if many threads commit in parallel
+        XTypeRegistry(const std::size_t n_shards = 1);
 
         // Need virtual destructor to become polymorphic (for pybind11)
-        virtual ~XTypeRegistry() = default;
+        /// Discards the queued prefetches and joins the prefetch and load threads
+        /// NOTE: A running prefetch keeps the registry alive until it has finished its current hop (see prefetch())
+        virtual ~XTypeRegistry();
 
         /// *** Classes API ***
 
@@ -64,6 +92,11 @@ namespace xtypes
         /// Import factory functions from other registry
         void import_from(const XTypeRegistry& other);
 
+        /// Returns the names of the relations of other which match the relation name of source inversely (see XType::add_fact())
+        /// The matches are precomputed for the registered classes when they are registered.
+        /// Returns nullptr if source or other do not use the schema of a registered class (e.g. because they defined relations at runtime)
+        const std::vector< std::string >* find_inverse_relations(const XType& source, const std::string& name, const XType& other) const;
+
         /// *** Instances API ***
         /// NOTE: These functions DO not register any instance, ownership of the shared pointers is completely given to to the caller
 
@@ -73,6 +106,20 @@ namespace xtypes
         /// Factory method to create XType from C++ type
         template <typename T> const std::shared_ptr<T> instantiate();
 
+        /// Sets how the instances created by the registry are tracked (default: STRONG)
+        /// NOTE: With WEAK or KEEP_NONE the caller has to hold the instances it needs. The facts returned by XType::get_facts() hold their targets
+        void set_temporary_policy(const TemporaryPolicy& policy);
+
+        /// Returns the current policy for temporary instances
+        TemporaryPolicy get_temporary_policy() const;
+
+        /// Removes all tracked instances which have expired (only relevant for the WEAK policy)
+        /// NOTE: This also happens automatically whenever the number of tracked instances has doubled
+        void compact_temporary_instances();
+
+        /// Returns counters about the temporary instances
+        TemporaryStats get_temporary_stats() const;
+
         /// *** Valid instances API ***
         
         /// This function tells us if an XType with a given URI is known to the registry
@@ -81,8 +128,13 @@ namespace xtypes
         /// If an XType has become valid (externally) it can be passed to the registry to be persistently stored
         /// Then others can find this instance by uri
         /// overwrite_if_exists speicifies if the content of the committed entity shall be copied over the existing one
+        /// NOTE: Temporary copies handed out by get_by_uri() before keep their content. Afterwards get_by_uri() hands out a new copy
         bool commit(XTypeCPtr& instance, const bool overwrite_if_exists);
 
+        /// Same as commit() for several instances at once. Every shard is locked only once for the whole batch
+        /// Returns the number of committed instances (instances with an invalid uri are skipped)
+        std::size_t commit_many(const std::vector< XTypePtr >& instances, const bool overwrite_if_exists);
+
         /// This function creates a new temporary object with the content of an valid instance in _valid_instances
         XTypeCPtr get_by_uri(const std::string& uri);
 
@@ -96,6 +148,82 @@ namespace xtypes
         /// Set the load_func to be used by the registry to resolve an XType given the uri
         void set_load_func(const LoadByUriFunc& f);
 
+        /// Resolves several uris at once. The result has the same order as uris (nullptr if an uri could not be resolved)
+        /// All uris unknown to the registry are passed to the load_many_func in ONE call (if set, otherwise the load_func is called for each)
+        std::vector< XTypePtr > load_many(const std::vector< std::string >& uris);
+
+        /// Defintion of a function to lookup several unknown XTypes from some information source in one round trip
+        /// The returned instances can be in any order. Uris which cannot be resolved shall be left out (or returned as nullptr)
+        using LoadManyByUriFunc = std::function< std::vector< XTypePtr >(const std::vector< std::string >& uris) >;
+
+        /// Set the load_many_func to be used by the registry to resolve several XTypes given their uris
+        /// NOTE: If no load_func has been set, load_by_uri() uses this function as well
+        void set_load_many_func(const LoadManyByUriFunc& f);
+
+        /// *** Asynchronous resolution API ***
+        /// NOTE: These functions call the load_func/load_many_func from other threads, so both have to be thread safe
+
+        /// Runs load_by_uri() in the background
+        /// The loads are queued for a fixed number of threads owned by the registry (see max_load_threads)
+        /// NOTE: The load functions must not wait for other asynchronous loads, because these might never get a thread
+        std::future< XTypePtr > load_by_uri_async(const std::string& uri);
+
+        /// Runs load_many() in the background
+        /// If no load_many_func has been set, the load_func is called for all unknown uris concurrently (see load_by_uri_async())
+        std::future< std::vector< XTypePtr > > load_many_async(const std::vector< std::string >& uris);
+
+        /// Maximum number of threads which run asynchronous loads
+        static constexpr std::size_t max_load_threads = 8;
+
+        /// Sets how many hops XType::get_facts() speculatively resolves beyond the targets it returns (default: 0 = no prefetching)
+        void set_prefetch_depth(const std::size_t depth);
+
+        /// Returns the current prefetch depth
+        std::size_t get_prefetch_depth() const;
+
+        /// Resolves the unresolved fact targets of the given (valid) instances up to depth hops away in the background
+        /// The prefetches are queued for a fixed number of threads owned by the registry (see max_prefetch_threads)
+        /// NOTE: Prefetching is speculative, so any errors of the load functions are ignored and prefetches are discarded if too many are queued already
+        /// NOTE: Only registries owned by a shared_ptr prefetch
+        void prefetch(const std::vector< std::string >& uris, const std::size_t depth);
+
+        /// Maximum number of threads which run prefetches and of prefetches which wait for them
+        static constexpr std::size_t max_prefetch_threads = 2;
+        static constexpr std::size_t max_queued_prefetches = 64;
+
+        /// Blocks until all running prefetches are done (e.g. call it before the load functions become invalid)
+        void wait_for_prefetches();
+
+        /// Encodes all valid instances in the binary format of BinaryGraphWriter (see XType::export_binary())
+        std::vector< std::uint8_t > export_binary() const;
+
+        /// Imports and commits all XTypes of a document written by export_binary(). Returns the number of committed XTypes
+        std::size_t import_binary(const std::vector< std::uint8_t >& data);
+
+        /// Writes all valid instances to a snapshot file which can be mapped by open_snapshot()
+        /// Returns the number of written instances
+        std::size_t write_snapshot(const std::string& path) const;
+
+        /// Maps a snapshot file read-only. Uris which are not committed are then looked up in the snapshot
+        /// and their XTypes are materialized (and committed) when get_by_uri() is called for them the first time
+        /// NOTE: A dropped uri is materialized from the snapshot again
+        void open_snapshot(const std::string& path);
+
+        /// Unmaps the snapshot. Already materialized instances stay committed
+        void close_snapshot();
+
+        /// Receives the uri and the record (in the layout of XType::export_record()) of a changed XType
+        using ChangeWriter = std::function< void(const std::string& uri, const nlohmann::json& record) >;
+
+        /// Commits and writes every XType of this registry which has been modified since the last call (or since it was created)
+        /// Properties are always exported completely, relations only if their facts have changed. Afterwards the XTypes are checkpointed (see XType::clear_changes())
+        /// Returns the number of written XTypes
+        /// NOTE: Instances loaded or imported from a serialization (import_from(), snapshots, ...) are not reported until they are modified
+        std::size_t export_changes(const ChangeWriter& writer);
+
+        /// Called by XType when it has been modified after its last checkpoint
+        void track_change(const XTypeWeakPtr& instance);
+
         /// Removes an valid instance from registry
         /// TODO: This could invalidate other dependent XTypes. Has to be handled!
         void drop(const std::string& uri);
@@ -104,21 +232,98 @@ namespace xtypes
         void clear();
 
     private:
+        /// A part of the valid instances (selected by the hash of their uri)
+        struct Shard
+        {
+            mutable std::shared_mutex mutex;
+            // Every uri known to the shard is interned here. The tables below are indexed by its handles
+            UriTable uris;
+            // When a temporary copy of a valid instance is created it is registered here
+            // analogous to GIT MODIFIED FILES
+            std::vector< XTypeWeakPtr > valid_to_temporary;
+            // Table of uri handle to XType instances (nullptr if there is none)
+            // NOTE: This table stores all XTypes committed to this registry whose uri belongs to this shard
+            // Only XTypes with a valid uri can be stored in here (either loaded from DB or created and registered)
+            // analogous to GIT VERSIONED/COMMITTED FILES
+            std::vector< XTypePtr > valid_instances;
+
+            /// Returns the valid instance of an interned uri or nullptr
+            const XTypePtr& valid_instance(const UriHandle handle) const;
+            /// Interns an uri and makes sure that the tables have an entry for it
+            UriHandle insert(const std::string& uri, const std::size_t hash);
+        };
+
+        /// Returns the index of the shard an uri belongs to
+        std::size_t shard_index(const std::size_t hash) const;
+        /// Returns the shard an uri belongs to
+        Shard& shard_of(const std::size_t hash) const;
+
+        /// Implementation of get_by_uri() without the snapshot lookup
+        XTypeCPtr get_committed(const std::string& uri);
+
+        /// Instantiates and commits the XType of uri from the snapshot. Returns false if the snapshot does not know it
+        bool materialize(const std::string& uri);
+
+        /// Returns the target uris of all unresolved facts of the valid instance of uri
+        std::vector< std::string > unresolved_uris_of(const std::string& uri) const;
+
+        /// Stores instance as the valid instance of uri (expects the mutex of shard to be locked exclusively)
+        void commit_locked(Shard& shard, XTypeCPtr& instance, const std::string& uri, const std::size_t hash, const bool overwrite_if_exists);
+
+        /// Adds the class created by factory to _inverse_relations (expects _factories_mutex to be locked exclusively)
+        void register_inverse_relations(const std::function<UniqueXTypePtr()>& factory);
+
+        /// The precomputed inverse relations of a registered class
+        struct InverseRelations
+        {
+            // Keeps the schema (and therefore its address) alive
+            std::shared_ptr< const ClassSchema > schema;
+            // relation name -> schema of a registered class -> names of its relations which match inversely
+            std::map< std::string, std::unordered_map< const ClassSchema*, std::vector< std::string > > > matches;
+        };
+
         // Factory function repository: classname -> factory function
-        std::map<std::string, std::function<UniqueXTypePtr()>> _factories;
+        std::unordered_map<std::string, std::function<UniqueXTypePtr()>> _factories;
+        // Schema of a registered class -> its inverse relations
+        std::unordered_map< const ClassSchema*, InverseRelations > _inverse_relations;
         // A function to load unknown XTypes from some information source
         LoadByUriFunc _load_func;
+        // A function to load several unknown XTypes at once
+        LoadManyByUriFunc _load_many_func;
+        // A read-only snapshot of valid instances (might be nullptr)
+        std::shared_ptr< const RegistrySnapshot > _snapshot;
+        // Protects _factories, _inverse_relations, _load_func, _load_many_func and _snapshot
+        mutable std::shared_mutex _factories_mutex;
+        /// Starts tracking a new temporary instance according to the policy
+        void track_temporary(const XTypePtr& instance);
+        /// Removes expired instances from _weak_temporary_instances (expects _temporary_instances_mutex to be locked)
+        void compact_weak_temporaries();
+
         // Every instantiated XType is registered here (might not be valid yet)
         // analogous to GIT UNVERSIONED FILES
+        // NOTE: Which of both is used depends on _temporary_policy
         std::vector< XTypePtr > _temporary_instances;
-        // When a temporary copy of a valid instance is created it is registered here
-        // analogous to GIT MODIFIED FILES
-        std::map< std::string, XTypeWeakPtr > _valid_to_temporary;
-        // Map of uri to XType instances
-        // NOTE: This map GLOBALLY stores all XTypes committed to this registry
-        // Only XTypes with a valid uri can be stored in here (either loaded from DB or created and registered)
-        // analogous to GIT VERSIONED/COMMITTED FILES
-        std::map< std::string, XTypePtr > _valid_instances;
+        std::vector< XTypeWeakPtr > _weak_temporary_instances;
+        TemporaryPolicy _temporary_policy = TemporaryPolicy::STRONG;
+        TemporaryStats _temporary_stats;
+        // The size of _weak_temporary_instances which triggers the next compaction
+        std::size_t _next_compaction = 1024;
+        mutable std::mutex _temporary_instances_mutex;
+        // Number of hops to prefetch
+        std::size_t _prefetch_depth = 0;
+        mutable std::mutex _prefetch_mutex;
+        // The queued prefetches and asynchronous loads and the threads running them
+        // NOTE: Shared with the threads, because the last owner of the registry might be one of them
+        struct TaskQueue;
+        std::shared_ptr< TaskQueue > _prefetch_queue;
+        std::shared_ptr< TaskQueue > _load_queue;
+        // Every XType with changes since its last checkpoint (might include expired or duplicate entries)
+        std::vector< XTypeWeakPtr > _changed;
+        // The size of _changed which triggers the next removal of expired entries
+        std::size_t _next_changed_compaction = 1024;
+        mutable std::mutex _changes_mutex;
+        // NOTE: unique_ptr, because a shared_mutex cannot be moved
+        std::vector< std::unique_ptr< Shard > > _shards;
     };
 
     using XTypeRegistryPtr = std::shared_ptr<XTypeRegistry>;
@@ -132,11 +337,13 @@ namespace xtypes
 
     template <typename T> void XTypeRegistry::register_class()
     {
-        if (knows_class(T::classname))
+        std::unique_lock< std::shared_mutex > lock(_factories_mutex);
+        if (_factories.count(T::classname))
             return;
         _factories[T::classname] = []{ 
             return std::make_unique<T>();
         };
+        register_inverse_relations(_factories[T::classname]);
     }
 
     // This function is needed to automatically place a ref to the registry in new XTypes
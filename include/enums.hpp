@@ -84,6 +84,32 @@ namespace xtypes {
         "CONFIGURED_FOR"
     };
 
+    /// Specifies how the registry keeps track of the temporary instances it has created
+    enum class TemporaryPolicy
+    {
+        KEEP_NONE = 0, /* < temporary instances are not tracked at all */
+        WEAK = 1,      /* < temporary instances are tracked as long as someone else holds them */
+        STRONG = 2     /* < temporary instances are kept alive by the registry until clear() */
+    };
+    static const char* TemporaryPolicy2Str[] = {
+        "KEEP_NONE",
+        "WEAK",
+        "STRONG"
+    };
+
+    /// Specifies how uri_to_uuid() hashes an uri (see Hashing.hpp)
+    enum class UuidScheme
+    {
+        CRC32 = 0,  /* < CRC-32 (ISO-HDLC, same as zlib), the scheme of all data written before the schemes existed */
+        CRC32C = 1, /* < CRC-32C (Castagnoli), uses the SSE4.2 instruction if available */
+        CRC64 = 2   /* < CRC-64/XZ, 64 bit uuids for large registries */
+    };
+    static const char* UuidScheme2Str[] = {
+        "CRC32",
+        "CRC32C",
+        "CRC64"
+    };
+
     static const std::map<nlohmann::json::value_t, std::string> value_t2string = {
       {nlohmann::json::value_t::null, "null"},
       {nlohmann::json::value_t::boolean, "boolean"},
@@ -3,13 +3,52 @@
 #include <nlohmann/json.hpp>
 
 #include "enums.hpp"
+#include "CopyOnWrite.hpp"
 #include <set>
+#include <map>
+#include <vector>
+#include <string>
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <initializer_list>
+#include <iterator>
+#include <unordered_map>
 
 namespace nl = nlohmann;
 
 namespace xtypes {
+    /// Compact identifier of an interned classname (see intern_name())
+    using NameId = std::uint32_t;
+
+    /// Returns the id of a name. Unknown names are interned process wide (thread safe)
+    /// NOTE: Ids are dense (0, 1, 2, ...) and stay valid (and so do the references returned by name_of())
+    NameId intern_name(const std::string& name);
+
+    /// Returns the name of an interned id
+    const std::string& name_of(const NameId id);
+
+    /// A property key which has been parsed once and can then be used for fast lookups (see PropertySchema::find_slot())
+    struct PropertyKey
+    {
+        PropertyKey(const std::string& path_to_key);
+
+        /// The path to the key without leading '/'
+        std::string key;
+        nl::json::json_pointer pointer;
+        std::size_t hash;
+    };
+
+    /// Compiled information about a single property of a PropertySchema
+    struct PropertySlot
+    {
+        std::string key;
+        nl::json::json_pointer pointer;
+        std::size_t hash;
+        nl::json::value_t type;
+        std::set<nl::json> allowed_values;
+    };
+
     /// Holds information about property schemata
     struct PropertySchema
     {
@@ -17,6 +56,9 @@ namespace xtypes {
         nl::json allowed_values;
         nl::json default_values;
 
+        /// Returned by find_slot() if there is no slot for a key
+        static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
         nl::json to_json() const {
             nl::json out;
             out["property_types"] = property_types;
@@ -41,41 +83,63 @@ namespace xtypes {
             {
                 throw std::invalid_argument("PropertySchema::define_property(): Property " + path_to_key + " already defined!");
             }
-            nl::json::json_pointer jptr(to_pointer(path_to_key));
-            this->property_types[jptr] = type;
-            this->allowed_values[jptr] = allowed_values;
             if (!default_value.is_null())
             {
                 // Check if type matches
-                if (!this->is_type_matching(path_to_key, default_value))
+                if (!is_type_matching(type, default_value))
                 {
                     throw std::invalid_argument("PropertySchema::define_property(): Invalid default value " + default_value.dump() + " for " + path_to_key);
                 }
             }
+            nl::json::json_pointer jptr(to_pointer(path_to_key));
+            this->property_types[jptr] = type;
+            this->allowed_values[jptr] = allowed_values;
             this->default_values[jptr] = default_value;
+            this->add_slot(PropertyKey(path_to_key), type, allowed_values);
         }
 
         bool has_property(const std::string& path_to_key) const
         {
+            if (this->find_slot(path_to_key) != npos)
+                return true;
+            // NOTE: Intermediate keys of nested properties have no slot
             nl::json::json_pointer jptr(to_pointer(path_to_key));
             return this->property_types.contains(jptr);
         }
 
         nl::json::value_t get_property_type(const std::string& path_to_key) const
         {
+            const std::size_t slot = this->find_slot(path_to_key);
+            if (slot != npos)
+                return this->slots[slot].type;
             nl::json::json_pointer jptr(to_pointer(path_to_key));
             return this->property_types.at(jptr);
         }
 
         std::set<nl::json> get_allowed_property_values(const std::string& path_to_key) const
         {
+            const std::size_t slot = this->find_slot(path_to_key);
+            if (slot != npos)
+                return this->slots[slot].allowed_values;
             nl::json::json_pointer jptr(to_pointer(path_to_key));
             return this->allowed_values.at(jptr);
         }
 
         bool is_allowed_value(const std::string& path_to_key, const nl::json& value) const
         {
-            auto allowed_values = this->get_allowed_property_values(path_to_key);
+            const std::size_t slot = this->find_slot(path_to_key);
+            if (slot != npos)
+                return is_allowed_value(this->slots[slot].allowed_values, value);
+            return is_allowed_value(this->get_allowed_property_values(path_to_key), value);
+        }
+
+        bool is_type_matching(const std::string& path_to_key, const nl::json &value) const
+        {
+            return is_type_matching(this->get_property_type(path_to_key), value);
+        }
+
+        static bool is_allowed_value(const std::set<nl::json>& allowed_values, const nl::json& value)
+        {
             if (allowed_values.size() < 1)
             {
                 // No constraint set, so allow it
@@ -90,25 +154,88 @@ namespace xtypes {
             return false;
         }
 
-        bool is_type_matching(const std::string& path_to_key, const nl::json &value) const
+        static bool is_type_matching(const nl::json::value_t& type, const nl::json &value)
         {
             // Types match directly
-            if (this->get_property_type(path_to_key) == value.type())
+            if (type == value.type())
                 return true;
             // Sometimes an unsigned/signed integer shall be assigned to an signed/unsigned value
             // NOTE: This can happen if nlohmann::json interprets an signed value as being an unsigned value
-            if (this->get_property_type(path_to_key) == nl::json::value_t::number_integer && value.type() == nl::json::value_t::number_unsigned)
+            if (type == nl::json::value_t::number_integer && value.type() == nl::json::value_t::number_unsigned)
                 return true; // TODO: Check that unsigned value < signed positive max!
-            if (this->get_property_type(path_to_key) == nl::json::value_t::number_unsigned && value.type() == nl::json::value_t::number_integer)
+            if (type == nl::json::value_t::number_unsigned && value.type() == nl::json::value_t::number_integer)
                 return value >= 0U;
             // The initial type is discarded, so we match anything
-            if (this->get_property_type(path_to_key) == nl::json::value_t::discarded)
+            if (type == nl::json::value_t::discarded)
                 return true;
             // For dictionaries we have to handle the empty dict initialization case
-            if (this->get_property_type(path_to_key) == nl::json::value_t::object && value.type() == nl::json::value_t::null)
+            if (type == nl::json::value_t::object && value.type() == nl::json::value_t::null)
                 return true;
             return false;
         }
+
+        /* Compiled slot table */
+
+        /// Returns the slot of a (leaf) property or npos if there is none
+        std::size_t find_slot(const PropertyKey& key) const;
+        std::size_t find_slot(const std::string& path_to_key) const;
+
+        /// Returns all slots in the order the properties have been defined
+        const std::vector< PropertySlot >& get_slots() const { return this->slots; }
+
+        /// Returns the values of all properties of this schema in a single pass over the slots:
+        /// The valid entries of values are taken over, all other properties get their default values.
+        /// Returns null if the schema has no properties (e.g. for most relations)
+        nl::json validated_values(const nl::json& values) const;
+
+        /// Rebuilds the slot table from property_types and allowed_values.
+        /// Only needed if these have been modified directly.
+        void compile();
+
+    private:
+        void add_slot(const PropertyKey& key, const nl::json::value_t& type, const std::set<nl::json>& allowed_values);
+        void rebuild_slot_buckets();
+
+        std::vector< PropertySlot > slots;
+        /// Open addressing hash table of slot indices (+1, 0 marks an empty bucket)
+        std::vector< std::size_t > slot_buckets;
+    };
+
+    /** A set of classnames which keeps the interned ids of its names (see intern_name()) in ascending order.
+     * Every modification interns the names again, so relations can always be compared by their ids */
+    class ClassnameSet
+    {
+    public:
+        using const_iterator = std::set<std::string>::const_iterator;
+
+        ClassnameSet() = default;
+        ClassnameSet(std::set<std::string> names);
+        ClassnameSet(std::initializer_list<std::string> names);
+
+        const std::set<std::string>& names() const { return m_names; }
+        operator const std::set<std::string>&() const { return m_names; }
+        const std::vector< NameId >& ids() const { return m_ids; }
+
+        bool insert(const std::string& name);
+        std::size_t erase(const std::string& name);
+        void clear();
+
+        std::size_t size() const { return m_names.size(); }
+        bool empty() const { return m_names.empty(); }
+        std::size_t count(const std::string& name) const { return m_names.count(name); }
+        const_iterator begin() const { return m_names.begin(); }
+        const_iterator end() const { return m_names.end(); }
+
+        bool operator==(const ClassnameSet& other) const { return m_ids == other.m_ids; }
+        bool operator!=(const ClassnameSet& other) const { return m_ids != other.m_ids; }
+        bool operator==(const std::set<std::string>& other) const { return m_names == other; }
+        bool operator!=(const std::set<std::string>& other) const { return m_names != other; }
+
+    private:
+        void intern();
+
+        std::set<std::string> m_names;
+        std::vector< NameId > m_ids;
     };
 
     /// Holds the informations about a Relation
@@ -116,8 +243,8 @@ namespace xtypes {
     {
         RelationType relation_type;
         RelationType subrelation_of;
-        std::set<std::string> from_classnames;
-        std::set<std::string> to_classnames;
+        ClassnameSet from_classnames;
+        ClassnameSet to_classnames;
         Constraint constraint;
         DeletePolicy delete_policy;
         PropertySchema property_schema;
@@ -129,17 +256,21 @@ namespace xtypes {
 
         bool operator==(const Relation& other) const
         {
-            bool from_in_other = std::includes(from_classnames.begin(), from_classnames.end(), other.from_classnames.begin(), other.from_classnames.end());
-            bool other_in_from = std::includes(other.from_classnames.begin(), other.from_classnames.end(), from_classnames.begin(), from_classnames.end());
-            bool to_in_other = std::includes(to_classnames.begin(), to_classnames.end(), other.to_classnames.begin(), other.to_classnames.end());
-            bool other_in_to = std::includes(other.to_classnames.begin(), other.to_classnames.end(), to_classnames.begin(), to_classnames.end());
-            return relation_type == other.relation_type &&
-                   subrelation_of == other.subrelation_of &&
-                   // NOTE: Relations are considered to be equal to another if the domain and codomain are subsets of the other domains or vice versa
-                   (from_in_other || other_in_from) &&
-                   (to_in_other || other_in_to) &&
-                   constraint == other.constraint &&
-                   delete_policy == other.delete_policy;
+            if (relation_type != other.relation_type ||
+                subrelation_of != other.subrelation_of ||
+                constraint != other.constraint ||
+                delete_policy != other.delete_policy)
+                return false;
+            // NOTE: Relations are considered to be equal to another if the domain and codomain are subsets of the other domains or vice versa
+            return is_subset_or_superset(from_classnames.ids(), other.from_classnames.ids()) &&
+                   is_subset_or_superset(to_classnames.ids(), other.to_classnames.ids());
+        }
+
+        /// Returns true if one of the sorted ranges includes the other
+        template< typename Sorted >
+        static bool is_subset_or_superset(const Sorted& a, const Sorted& b)
+        {
+            return std::includes(a.begin(), a.end(), b.begin(), b.end()) || std::includes(b.begin(), b.end(), a.begin(), a.end());
         }
 
         nl::json operator[](std::string key) const {
@@ -150,8 +281,8 @@ namespace xtypes {
             nl::json out;
             out["relation_type"] = relation_type;
             out["subrelation_of"] = subrelation_of;
-            out["from_classnames"] = from_classnames;
-            out["to_classnames"] = to_classnames;
+            out["from_classnames"] = from_classnames.names();
+            out["to_classnames"] = to_classnames.names();
             out["constraint"] = Constraint2Str[(int)constraint];
             out["delete_policy"] = DeletePolicy2Str[(int)delete_policy];
             out["property_schema"] = property_schema.to_json();
@@ -159,6 +290,16 @@ namespace xtypes {
         }
     };
 
+    /// Holds the property and relation definitions of an XType class
+    /// NOTE: XTypes share one instance with all others of the same class as long as they do not define anything at runtime
+    struct ClassSchema
+    {
+        PropertySchema property_schema;
+        std::map< std::string, Relation > relations;        /* < specifies which relation is attached to the corresponding entry in facts */
+        std::map< std::string, bool > relation_dir_forward; /* < specifies whether the target (forward direction) or the source of a relation is filled into the corresponding entry in facts */
+        CopyOnWrite< nl::json > default_properties;         /* < the properties of a freshly constructed instance (shared with them until they are modified) */
+    };
+
     class XType;
 
     /// A fact is referring to an target Xtype
@@ -168,12 +309,19 @@ namespace xtypes {
         std::weak_ptr< XType > target;
         nl::json edge_properties;
 
-        Fact(std::weak_ptr<XType> target, const nl::json& edge_properties);
+        Fact(std::weak_ptr<XType> target, nl::json edge_properties);
 
         bool operator!=(const Fact& other) const;
         bool operator==(const Fact& other) const;
     };
 
+    /// The facts returned by XType::get_facts() together with their targets
+    /// A registry with TemporaryPolicy::WEAK or KEEP_NONE does not hold the targets, so they are held here as long as the result lives
+    /// NOTE: The facts stored by an XType never hold their targets, so cyclic graphs can still expire. Copying the result into a plain std::vector< Fact > drops the targets
+    struct PinnedFacts : public std::vector< Fact > {
+        std::vector< std::shared_ptr< XType > > targets; /* < the target of the fact at the same index */
+    };
+
     /// An extended fact is referring to an target Xtype
     /// The target is either specified by an URI or by an weak pointer
     /// target_uri == empty and target == nullptr is an empty fact
@@ -181,8 +329,8 @@ namespace xtypes {
     /// target_uri == empty and target != nullptr means that the fact is pending and the target might not yet been fully valid (e.g. is_uri_valid() is false)
     /// target_uri != empty and target != nullptr means that the fact has been resolved and target_uri matches target.lock()->uri()
     struct ExtendedFact : public Fact {
-        ExtendedFact(const std::string& target_uri, const nl::json& edge_properties);
-        ExtendedFact(std::weak_ptr<XType> target, const nl::json& edge_properties);
+        ExtendedFact(const std::string& target_uri, nl::json edge_properties);
+        ExtendedFact(std::weak_ptr<XType> target, nl::json edge_properties);
 
         bool operator!=(const ExtendedFact& other) const;
         bool operator==(const ExtendedFact& other) const;
@@ -193,8 +341,134 @@ namespace xtypes {
         // the setter will invalidate the target iff
         // uri is not empty and target uri is invalid OR does not match
         void target_uri(const std::string& uri);
+        // true if target_uri(target_uri()) would not change anything
+        bool is_target_uri_current() const;
 
         private:
+            friend class FactList;
             std::string _target_uri;
     };
+
+    /** The facts of a relation in insertion order.
+     * The facts are indexed by their target and by the uuid of their target uri, so find() and remove() do not have to compare all facts.
+     * Removed facts leave a gap which is closed once more than half of the entries are gaps.
+     * NOTE: The uuid index uses the uris the targets had when their facts have been indexed.
+     * If the uri of a target has changed since then (see XType::uri_changes_since()), find() might miss its fact until refresh() has been called */
+    class FactList
+    {
+    public:
+        /// Returned by find() if there is no matching fact
+        static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+        /// Iterates over the facts in insertion order
+        class const_iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = ExtendedFact;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const ExtendedFact*;
+            using reference = const ExtendedFact&;
+
+            const_iterator(const FactList* list, const std::size_t slot) : list(list), slot(slot) { this->skip_removed(); }
+
+            reference operator*() const { return this->list->entries[this->slot]; }
+            pointer operator->() const { return &this->list->entries[this->slot]; }
+            const_iterator& operator++() { ++this->slot; this->skip_removed(); return *this; }
+            const_iterator operator++(int) { const_iterator before(*this); ++(*this); return before; }
+            bool operator==(const const_iterator& other) const { return this->slot == other.slot; }
+            bool operator!=(const const_iterator& other) const { return this->slot != other.slot; }
+
+            /// Returns the slot of the current fact (see get())
+            std::size_t get_slot() const { return this->slot; }
+
+        private:
+            void skip_removed()
+            {
+                while ((this->slot < this->list->entries.size()) && this->list->removed[this->slot])
+                    ++this->slot;
+            }
+
+            const FactList* list;
+            std::size_t slot;
+        };
+
+        FactList();
+        FactList(std::initializer_list< ExtendedFact > facts);
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, this->entries.size()); }
+
+        /// Returns the number of facts
+        std::size_t size() const { return this->entries.size() - this->n_removed; }
+        bool empty() const { return this->size() == 0; }
+
+        /// Returns the slot of a fact which is equal to fact (see ExtendedFact::operator==()) or npos
+        std::size_t find(const ExtendedFact& fact) const;
+        bool contains(const ExtendedFact& fact) const { return this->find(fact) != npos; }
+
+        /// Returns the fact in a slot returned by find() or const_iterator::get_slot()
+        const ExtendedFact& get(const std::size_t slot) const { return this->entries.at(slot); }
+
+        /// Appends a fact (without checking for duplicates)
+        void push_back(ExtendedFact fact);
+        template< typename... Args >
+        void emplace_back(Args&&... args) { this->push_back(ExtendedFact(std::forward< Args >(args)...)); }
+        void reserve(const std::size_t n);
+
+        /// Modifies the fact in a slot by calling f(fact) and updates the index afterwards
+        template< typename F >
+        void update(const std::size_t slot, F&& f)
+        {
+            this->unindex(slot);
+            f(this->entries.at(slot));
+            this->index(slot);
+        }
+
+        /// Removes the fact in a slot. Slots of other facts stay valid unless the gaps are closed (see remove())
+        void erase(const std::size_t slot);
+
+        /// Removes all facts which are equal to fact. Returns the number of removed facts
+        /// NOTE: This might close the gaps and thereby change the slots of the remaining facts
+        std::size_t remove(const ExtendedFact& fact);
+
+        /// Returns false if any uri has been invalidated since the facts have been indexed (see XType::uri_epoch())
+        bool is_index_current() const;
+
+        /// Indexes the facts whose targets have changed their uri since the last refresh() again
+        /// NOTE: The facts of targets whose uri is built from facts (see XType::get_uri_relations()) are always checked
+        void refresh();
+
+        /// Rebuilds the index with the current uris of the targets
+        void reindex();
+
+    private:
+        /// Returns the index key of a fact. Returns false if the fact has neither a target nor a target uri
+        static bool uuid_of(const ExtendedFact& fact, std::size_t& uuid);
+        void index(const std::size_t slot);
+        void unindex(const std::size_t slot);
+        /// Removes the gaps left by erase() and rebuilds the index
+        void compact();
+
+        /// The keys a fact has been indexed with
+        struct IndexKeys
+        {
+            const XType* target = nullptr;
+            bool has_uuid = false;
+            std::size_t uuid = 0;
+            /// The uri revision of a target whose uri is built from facts (0 otherwise)
+            std::uint64_t derived_revision = 0;
+        };
+
+        std::vector< ExtendedFact > entries;
+        std::vector< IndexKeys > keys;
+        std::vector< bool > removed;
+        std::size_t n_removed = 0;
+        std::unordered_multimap< const XType*, std::size_t > by_target;
+        std::unordered_multimap< std::size_t, std::size_t > by_uuid;
+        /// The slots of facts whose targets build their uri from facts
+        std::set< std::size_t > derived_slots;
+        /// The value of XType::uri_epoch() when the uuid index has been refreshed
+        std::uint64_t epoch;
+    };
 }
@@ -5,7 +5,7 @@
 #include <fstream>
 #include <exception>
 
-#include "CRC.h"
+#include "Hashing.hpp"
 
 namespace nl = nlohmann;
 
@@ -25,13 +25,18 @@ namespace xtypes {
     }
   }
 
-  /// Converts the URI to a UUID
+  /// Converts the URI to a UUID with the scheme selected by set_uuid_scheme() (CRC32 unless changed)
   static std::size_t uri_to_uuid(const std::string& uri)
   {
-    // NOTE: We use CRC32 here to have a platform INDEPENDENT, FAST, LOW-COLLISION hashing value
-    // If this is not enough, the CRC.h file also supports ESOTERIC CRC64
+    // NOTE: We use CRCs here to have a platform INDEPENDENT, FAST, LOW-COLLISION hashing value
     // For a nice comparison of some hash functions, see
     // https://softwareengineering.stackexchange.com/questions/49550/which-hashing-algorithm-is-best-for-uniqueness-and-speed
-    return CRC::Calculate(uri.c_str(), uri.length(), CRC::CRC_32());
+    return hashing::hash(uri.data(), uri.size(), get_uuid_scheme());
+  }
+
+  /// Converts the URI to a UUID with the given scheme
+  static std::size_t uri_to_uuid(const std::string& uri, const UuidScheme scheme)
+  {
+    return hashing::hash(uri.data(), uri.size(), scheme);
   }
 }
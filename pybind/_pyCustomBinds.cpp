@@ -8,6 +8,7 @@ void PYBIND11_INIT_XTYPES_GENERATOR__ENUMS(py::module_ &);
 void PYBIND11_INIT_XTYPES_GENERATOR__STRUCTS(py::module_ &);
 void PYBIND11_INIT_XTYPES_GENERATOR__UTILS(py::module_ &);
 void PYBIND11_INIT_XTYPES_GENERATOR__REGISTRY(py::module_ &);
+void PYBIND11_INIT_XTYPES_GENERATOR__INSTRUMENTATION(py::module_ &);
 
 PYBIND11_EXPORT
 void PYBIND11_INIT_XTYPES_GENERATOR__CUSTOM_BINDS(py::module_& m) {
@@ -15,4 +16,5 @@ void PYBIND11_INIT_XTYPES_GENERATOR__CUSTOM_BINDS(py::module_& m) {
   PYBIND11_INIT_XTYPES_GENERATOR__STRUCTS(m);
   PYBIND11_INIT_XTYPES_GENERATOR__UTILS(m);
   PYBIND11_INIT_XTYPES_GENERATOR__REGISTRY(m);
+  PYBIND11_INIT_XTYPES_GENERATOR__INSTRUMENTATION(m);
 }
@@ -20,6 +20,14 @@ void PYBIND11_INIT_XTYPES_GENERATOR__ENUMS(py::module_& m) {
         .value("DELETESOURCE", DeletePolicy::DELETESOURCE)
         .value("DELETETARGET", DeletePolicy::DELETETARGET)
         .value("DELETEBOTH", DeletePolicy::DELETEBOTH);
+    py::enum_<TemporaryPolicy>(m, "TemporaryPolicy")
+        .value("KEEP_NONE", TemporaryPolicy::KEEP_NONE)
+        .value("WEAK", TemporaryPolicy::WEAK)
+        .value("STRONG", TemporaryPolicy::STRONG);
+    py::enum_<UuidScheme>(m, "UuidScheme")
+        .value("CRC32", UuidScheme::CRC32)
+        .value("CRC32C", UuidScheme::CRC32C)
+        .value("CRC64", UuidScheme::CRC64);
     py::enum_<RelationType>(m, "RelationType")
         //.value("NONE", RelationType::NONE)
         .value("HAS", RelationType::HAS)
@@ -0,0 +1,22 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <nlohmann/json.hpp>
+#include <pybind11_json/pybind11_json.hpp>
+
+#include "Instrumentation.hpp"
+#include "Tracing.hpp"
+
+namespace py = pybind11;
+namespace nl = nlohmann;
+
+PYBIND11_EXPORT
+void PYBIND11_INIT_XTYPES_GENERATOR__INSTRUMENTATION(py::module_& m) {
+    py::module_ instrumentation = m.def_submodule("instrumentation", "Counters, latency histograms and tracing of the hot paths (only if built with XTYPES_INSTRUMENTATION)");
+    instrumentation.def("enabled", &xtypes::instrumentation::enabled)
+                   .def("snapshot", &xtypes::instrumentation::snapshot)
+                   .def("reset", &xtypes::instrumentation::reset)
+                   .def("start_tracing", &xtypes::tracing::start,
+                        py::arg("path"))
+                   .def("stop_tracing", &xtypes::tracing::stop)
+                   .def("is_tracing", &xtypes::tracing::is_running);
+}
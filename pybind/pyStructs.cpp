@@ -26,15 +26,20 @@ PYBIND11_EXPORT
 void PYBIND11_INIT_XTYPES_GENERATOR__STRUCTS(py::module_& m) {
     py::class_<PropertySchema>(m, "PropertySchema")
         .def(py::init())
-        .def_readwrite("property_types", &PropertySchema::property_types)
-        .def_readwrite("allowed_values", &PropertySchema::allowed_values)
+        // NOTE: Direct modifications of the schema have to be compiled again
+        .def_property("property_types",
+                      [](const PropertySchema& self) { return self.property_types; },
+                      [](PropertySchema& self, const nl::json& value) { self.property_types = value; self.compile(); })
+        .def_property("allowed_values",
+                      [](const PropertySchema& self) { return self.allowed_values; },
+                      [](PropertySchema& self, const nl::json& value) { self.allowed_values = value; self.compile(); })
         .def_readwrite("default_values", &PropertySchema::default_values)
         .def("define_property", &PropertySchema::define_property)
         .def("has_property", &PropertySchema::has_property)
         .def("get_property_type", &PropertySchema::get_property_type)
         .def("get_allowed_property_values", &PropertySchema::get_allowed_property_values)
-        .def("is_allowed_value", &PropertySchema::is_allowed_value)
-        .def("is_type_matching", &PropertySchema::is_type_matching)
+        .def("is_allowed_value", py::overload_cast<const std::string&, const nl::json&>(&PropertySchema::is_allowed_value, py::const_))
+        .def("is_type_matching", py::overload_cast<const std::string&, const nl::json&>(&PropertySchema::is_type_matching, py::const_))
         .def("to_json", &PropertySchema::to_json);
 
     py::class_<Relation>(m, "Relation")
@@ -42,8 +47,11 @@ void PYBIND11_INIT_XTYPES_GENERATOR__STRUCTS(py::module_& m) {
         .def("to_json", &Relation::to_json)
         .def_readwrite("relation_type", &Relation::relation_type)
         .def_readwrite("subrelation_of", &Relation::subrelation_of)
-        .def_readwrite("from_classnames", &Relation::from_classnames)
-        .def_readwrite("to_classnames", &Relation::to_classnames)
+        // NOTE: The domains have to be interned again after modifications
+        .def_property("from_classnames", [](const Relation& r) { return r.from_classnames.names(); },
+                      [](Relation& r, const std::set<std::string>& names) { r.from_classnames = names; })
+        .def_property("to_classnames", [](const Relation& r) { return r.to_classnames.names(); },
+                      [](Relation& r, const std::set<std::string>& names) { r.to_classnames = names; })
         .def_readwrite("constraint", &Relation::constraint)
         .def_readwrite("delete_policy", &Relation::delete_policy)
         .def_readwrite("property_schema", &Relation::property_schema)
@@ -15,7 +15,15 @@ void PYBIND11_INIT_XTYPES_GENERATOR__UTILS(py::module_& m) {
     m.def("parseJson", &xtypes::parseJson,
                 py::arg("string"),
                 py::arg("info")="")
-     .def("uri_to_uuid", &xtypes::uri_to_uuid,
+     .def("uri_to_uuid", py::overload_cast<const std::string&>(&xtypes::uri_to_uuid),
                 py::arg("uri")
+                )
+     .def("uri_to_uuid", py::overload_cast<const std::string&, const UuidScheme>(&xtypes::uri_to_uuid),
+                py::arg("uri"),
+                py::arg("scheme")
+                )
+     .def("get_uuid_scheme", &xtypes::get_uuid_scheme)
+     .def("set_uuid_scheme", &xtypes::set_uuid_scheme,
+                py::arg("scheme")
                 );
 }
@@ -13,9 +13,16 @@ using namespace xtypes;
 
 PYBIND11_EXPORT
 void PYBIND11_INIT_XTYPES_GENERATOR__REGISTRY(py::module_& m) {
+    py::class_<TemporaryStats>(m, "TemporaryStats")
+        .def_readonly("created", &TemporaryStats::created)
+        .def_readonly("tracked", &TemporaryStats::tracked)
+        .def_readonly("compactions", &TemporaryStats::compactions)
+        .def_readonly("reclaimed", &TemporaryStats::reclaimed);
+
     // NOTE: The 3rd argument is a different default holder. Default is std::unique_ptr but we need std::shared_ptr.
     py::class_<XTypeRegistry, std::shared_ptr<XTypeRegistry> >(m, "XTypeRegistry")
         .def(py::init())
+        .def(py::init<std::size_t>(), py::arg("n_shards"))
         .def("register_alias", &XTypeRegistry::register_alias)
         .def("get_classnames", &XTypeRegistry::get_classnames)
         .def("knows_class", &XTypeRegistry::knows_class)
@@ -23,9 +30,33 @@ void PYBIND11_INIT_XTYPES_GENERATOR__REGISTRY(py::module_& m) {
         .def("import_from", &XTypeRegistry::import_from)
         .def("knows_uri", &XTypeRegistry::knows_uri, py::arg("uri"))
         .def("commit", &XTypeRegistry::commit, py::arg("instance"), py::arg("overwrite_if_exists"))
+        .def("commit_many", &XTypeRegistry::commit_many, py::arg("instances"), py::arg("overwrite_if_exists"))
         .def("get_by_uri", py::overload_cast< const std::string& >(&XTypeRegistry::get_by_uri), py::arg("uri"))
         .def("load_by_uri", &XTypeRegistry::load_by_uri, py::arg("uri"))
         .def("set_load_func", &XTypeRegistry::set_load_func)
+        .def("load_many", &XTypeRegistry::load_many, py::arg("uris"))
+        .def("set_load_many_func", &XTypeRegistry::set_load_many_func)
+        // NOTE: The future based functions are not exposed. Use the prefetching instead
+        .def("set_prefetch_depth", &XTypeRegistry::set_prefetch_depth, py::arg("depth"))
+        .def("get_prefetch_depth", &XTypeRegistry::get_prefetch_depth)
+        .def("prefetch", &XTypeRegistry::prefetch, py::arg("uris"), py::arg("depth"))
+        .def("wait_for_prefetches", &XTypeRegistry::wait_for_prefetches, py::call_guard<py::gil_scoped_release>())
+        .def("export_binary", [](const XTypeRegistry& self) {
+            const std::vector< std::uint8_t > data(self.export_binary());
+            return py::bytes(reinterpret_cast< const char* >(data.data()), data.size());
+        })
+        .def("import_binary", [](XTypeRegistry& self, const py::bytes& data) {
+            const std::string buffer(data);
+            return self.import_binary(std::vector< std::uint8_t >(buffer.begin(), buffer.end()));
+        }, py::arg("data"))
+        .def("write_snapshot", &XTypeRegistry::write_snapshot, py::arg("path"))
+        .def("open_snapshot", &XTypeRegistry::open_snapshot, py::arg("path"))
+        .def("close_snapshot", &XTypeRegistry::close_snapshot)
+        .def("export_changes", &XTypeRegistry::export_changes, py::arg("writer"))
         .def("drop", &XTypeRegistry::drop, py::arg("uri"))
+        .def("set_temporary_policy", &XTypeRegistry::set_temporary_policy, py::arg("policy"))
+        .def("get_temporary_policy", &XTypeRegistry::get_temporary_policy)
+        .def("compact_temporary_instances", &XTypeRegistry::compact_temporary_instances)
+        .def("get_temporary_stats", &XTypeRegistry::get_temporary_stats)
         .def("clear", &XTypeRegistry::clear);
 }
@@ -0,0 +1,142 @@
+#include "BinaryFormat.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace xtypes;
+
+static const std::string binary_magic("XTYPESB");
+static const std::uint8_t binary_version = 1;
+
+namespace {
+    void put_uint(std::vector< std::uint8_t >& data, std::uint64_t value, const std::size_t n_bytes)
+    {
+        for (std::size_t i = 0; i < n_bytes; ++i, value >>= 8)
+            data.push_back(static_cast< std::uint8_t >(value & 0xff));
+    }
+
+    std::uint64_t get_uint(const std::vector< std::uint8_t >& data, const std::size_t offset, const std::size_t n_bytes)
+    {
+        if (offset + n_bytes > data.size())
+            throw std::runtime_error("BinaryGraphReader: Truncated document");
+        std::uint64_t value = 0;
+        for (std::size_t i = n_bytes; i > 0; --i)
+            value = (value << 8) | data[offset + i - 1];
+        return value;
+    }
+
+    /// Decodes the size prefixed MessagePack value at offset
+    nl::json get_value(const std::vector< std::uint8_t >& data, const std::size_t offset)
+    {
+        const std::size_t size = get_uint(data, offset, 4);
+        if (offset + 4 + size > data.size())
+            throw std::runtime_error("BinaryGraphReader: Truncated document");
+        try {
+            return nl::json::from_msgpack(data.begin() + offset + 4, data.begin() + offset + 4 + size);
+        } catch (const nl::json::parse_error& e) {
+            throw std::runtime_error(std::string("BinaryGraphReader: Invalid record: ") + e.what());
+        }
+    }
+}
+
+BinaryGraphWriter::BinaryGraphWriter()
+{
+    this->data.assign(binary_magic.begin(), binary_magic.end());
+    this->data.push_back(binary_version);
+}
+
+std::size_t BinaryGraphWriter::index_of(const std::string& s)
+{
+    const auto [it, inserted] = this->indices.emplace(s, this->strings.size());
+    if (inserted)
+        this->strings.push_back(s);
+    return it->second;
+}
+
+void BinaryGraphWriter::append(const nl::json& value)
+{
+    const std::size_t offset = this->data.size();
+    // Reserve the size prefix and encode the value behind it
+    put_uint(this->data, 0, 4);
+    nl::json::to_msgpack(value, this->data);
+    const std::uint64_t size = this->data.size() - offset - 4;
+    for (std::size_t i = 0; i < 4; ++i)
+        this->data[offset + i] = static_cast< std::uint8_t >((size >> (8 * i)) & 0xff);
+}
+
+void BinaryGraphWriter::add(const nl::json& record)
+{
+    nl::json relations = nl::json::array();
+    for (const auto& [rel_name, entries] : record.at("relations").items())
+    {
+        nl::json facts = nl::json::array();
+        for (const auto& entry : entries)
+        {
+            facts.push_back({this->index_of(entry.at("target").get_ref<const std::string&>()), entry.at("edge_properties")});
+        }
+        relations.push_back({this->index_of(rel_name), std::move(facts)});
+    }
+    this->append({this->index_of(record.at("uri").get_ref<const std::string&>()),
+                  this->index_of(record.at("classname").get_ref<const std::string&>()),
+                  record.at("properties"),
+                  std::move(relations)});
+    this->n_records++;
+}
+
+std::vector< std::uint8_t > BinaryGraphWriter::finish()
+{
+    const std::uint64_t table_offset = this->data.size();
+    this->append(this->strings);
+    put_uint(this->data, table_offset, 8);
+    put_uint(this->data, this->n_records, 8);
+    return std::move(this->data);
+}
+
+BinaryGraphReader::BinaryGraphReader(const std::vector< std::uint8_t >& data) : data(data)
+{
+    const std::size_t header_size = binary_magic.size() + 1;
+    if ((data.size() < header_size + 16) || !std::equal(binary_magic.begin(), binary_magic.end(), data.begin()))
+        throw std::runtime_error("BinaryGraphReader: Not an xtypes document");
+    if (data[binary_magic.size()] != binary_version)
+        throw std::runtime_error("BinaryGraphReader: Unsupported version " + std::to_string(data[binary_magic.size()]));
+    const std::size_t table_offset = get_uint(data, data.size() - 16, 8);
+    const std::size_t n_records = get_uint(data, data.size() - 8, 8);
+    if (table_offset >= data.size() - 16)
+        throw std::runtime_error("BinaryGraphReader: Invalid string table offset");
+    this->strings = get_value(data, table_offset).get< std::vector< std::string > >();
+    // Locate the records
+    this->offsets.reserve(std::min(n_records, table_offset / 5));
+    for (std::size_t offset = header_size; offset < table_offset; offset += 4 + get_uint(data, offset, 4))
+        this->offsets.push_back(offset);
+    if (this->offsets.size() != n_records)
+        throw std::runtime_error("BinaryGraphReader: Number of records does not match");
+}
+
+const std::string& BinaryGraphReader::string_at(const nl::json& index) const
+{
+    return this->strings.at(index.get<std::size_t>());
+}
+
+nl::json BinaryGraphReader::at(const std::size_t index) const
+{
+    nl::json node(get_value(this->data, this->offsets.at(index)));
+    // NOTE: We move the decoded values over instead of copying them
+    nl::json record(nl::json::value_t::object);
+    record["uri"] = this->string_at(node.at(0));
+    record["classname"] = this->string_at(node.at(1));
+    record["properties"] = std::move(node.at(2));
+    nl::json& relations(record["relations"]);
+    relations = nl::json::object();
+    for (auto& relation : node.at(3))
+    {
+        nl::json& entries(relations[this->string_at(relation.at(0))]);
+        entries = nl::json::array();
+        for (auto& fact : relation.at(1))
+        {
+            nl::json entry(nl::json::value_t::object);
+            entry["target"] = this->string_at(fact.at(0));
+            entry["edge_properties"] = std::move(fact.at(1));
+            entries.push_back(std::move(entry));
+        }
+    }
+    return record;
+}
@@ -0,0 +1,136 @@
+#include "Hashing.hpp"
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define XTYPES_HAS_SSE42_DISPATCH
+#endif
+
+using namespace xtypes;
+
+namespace {
+    /// Lookup tables of a reflected CRC. Table k advances a byte by k further zero bytes
+    template < typename T >
+    using Tables = std::array< std::array< T, 256 >, 8 >;
+
+    template < typename T >
+    constexpr Tables< T > make_tables(const T polynomial)
+    {
+        Tables< T > tables{};
+        for (std::size_t i = 0; i < 256; ++i)
+        {
+            T crc = static_cast< T >(i);
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc & 1) ? (crc >> 1) ^ polynomial : (crc >> 1);
+            tables[0][i] = crc;
+        }
+        for (std::size_t k = 1; k < 8; ++k)
+            for (std::size_t i = 0; i < 256; ++i)
+                tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+        return tables;
+    }
+
+    constexpr Tables< std::uint32_t > crc32_tables = make_tables< std::uint32_t >(0xEDB88320U);
+    constexpr Tables< std::uint32_t > crc32c_tables = make_tables< std::uint32_t >(0x82F63B78U);
+    constexpr Tables< std::uint64_t > crc64_tables = make_tables< std::uint64_t >(0xC96C5795D7870F42ULL);
+
+    /// Reads 8 (unaligned) bytes as little endian integer
+    inline std::uint64_t load_le64(const std::uint8_t* p)
+    {
+        std::uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        value = __builtin_bswap64(value);
+#endif
+        return value;
+    }
+
+    /// Updates a reflected CRC of at most 64 bits with 8 bytes per step
+    template < typename T >
+    T slicing_by_8(const Tables< T >& tables, T crc, const std::uint8_t* p, std::size_t size)
+    {
+        for (; size >= 8; size -= 8, p += 8)
+        {
+            const std::uint64_t word = load_le64(p) ^ crc;
+            crc = tables[7][word & 0xFF] ^ tables[6][(word >> 8) & 0xFF] ^
+                  tables[5][(word >> 16) & 0xFF] ^ tables[4][(word >> 24) & 0xFF] ^
+                  tables[3][(word >> 32) & 0xFF] ^ tables[2][(word >> 40) & 0xFF] ^
+                  tables[1][(word >> 48) & 0xFF] ^ tables[0][word >> 56];
+        }
+        for (; size > 0; --size, ++p)
+            crc = (crc >> 8) ^ tables[0][(crc ^ *p) & 0xFF];
+        return crc;
+    }
+
+#ifdef XTYPES_HAS_SSE42_DISPATCH
+    __attribute__((target("sse4.2")))
+    std::uint32_t crc32c_sse42(const std::uint8_t* p, std::size_t size)
+    {
+        std::uint64_t crc = 0xFFFFFFFFU;
+        for (; size >= 8; size -= 8, p += 8)
+            crc = _mm_crc32_u64(crc, load_le64(p));
+        std::uint32_t crc32 = static_cast< std::uint32_t >(crc);
+        for (; size > 0; --size, ++p)
+            crc32 = _mm_crc32_u8(crc32, *p);
+        return ~crc32;
+    }
+#endif
+
+    std::atomic< UuidScheme > uuid_scheme{UuidScheme::CRC32};
+}
+
+std::uint32_t hashing::crc32(const void* data, const std::size_t size)
+{
+    return ~slicing_by_8< std::uint32_t >(crc32_tables, 0xFFFFFFFFU, static_cast< const std::uint8_t* >(data), size);
+}
+
+std::uint32_t hashing::crc32c(const void* data, const std::size_t size)
+{
+#ifdef XTYPES_HAS_SSE42_DISPATCH
+    static const bool hardware = has_hardware_crc32c();
+    if (hardware)
+        return crc32c_sse42(static_cast< const std::uint8_t* >(data), size);
+#endif
+    return ~slicing_by_8< std::uint32_t >(crc32c_tables, 0xFFFFFFFFU, static_cast< const std::uint8_t* >(data), size);
+}
+
+std::uint64_t hashing::crc64(const void* data, const std::size_t size)
+{
+    return ~slicing_by_8< std::uint64_t >(crc64_tables, ~0ULL, static_cast< const std::uint8_t* >(data), size);
+}
+
+bool hashing::has_hardware_crc32c()
+{
+#ifdef XTYPES_HAS_SSE42_DISPATCH
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return false;
+#endif
+}
+
+std::uint64_t hashing::hash(const void* data, const std::size_t size, const UuidScheme scheme)
+{
+    switch (scheme)
+    {
+        case UuidScheme::CRC32:
+            return crc32(data, size);
+        case UuidScheme::CRC32C:
+            return crc32c(data, size);
+        case UuidScheme::CRC64:
+            return crc64(data, size);
+    }
+    throw std::invalid_argument("xtypes::hashing::hash(): Unknown UuidScheme " + std::to_string(static_cast< int >(scheme)));
+}
+
+UuidScheme xtypes::get_uuid_scheme()
+{
+    return uuid_scheme.load(std::memory_order_relaxed);
+}
+
+void xtypes::set_uuid_scheme(const UuidScheme scheme)
+{
+    uuid_scheme.store(scheme, std::memory_order_relaxed);
+}
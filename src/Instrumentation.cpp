@@ -0,0 +1,169 @@
+#include "Instrumentation.hpp"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace xtypes::instrumentation;
+
+std::uint64_t Histogram::quantile_ns(const double quantile) const
+{
+    if (this->count == 0)
+        return 0;
+    const double rank = quantile * this->count;
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < n_buckets; ++i)
+    {
+        seen += this->buckets[i];
+        if ((seen > 0) && (seen >= rank))
+            return (std::uint64_t(1) << (i + 1)) - 1;
+    }
+    return (std::uint64_t(1) << n_buckets) - 1;
+}
+
+nl::json Histogram::to_json() const
+{
+    nl::json result;
+    result["count"] = this->count;
+    result["total_ns"] = this->total_ns;
+    result["mean_ns"] = (this->count > 0) ? static_cast< double >(this->total_ns) / this->count : 0.0;
+    result["p50_ns"] = this->quantile_ns(0.5);
+    result["p99_ns"] = this->quantile_ns(0.99);
+    result["buckets"] = this->buckets;
+    return result;
+}
+
+#ifdef XTYPES_INSTRUMENTATION
+namespace {
+    /// All blocks ever handed out. They are never freed, so a thread can keep using its block pointer until the very end
+    struct Blocks
+    {
+        std::mutex mutex;
+        std::vector< std::unique_ptr< detail::Block > > all;
+        std::vector< detail::Block* > unused;
+    };
+
+    Blocks& blocks()
+    {
+        // NOTE: Intentionally leaked to be usable by thread_local destructors during shutdown
+        static Blocks* instance = new Blocks();
+        return *instance;
+    }
+
+    /// Hands the block of a thread back when the thread finishes
+    struct Owner
+    {
+        detail::Block* block;
+
+        Owner()
+        {
+            Blocks& b(blocks());
+            std::lock_guard< std::mutex > lock(b.mutex);
+            if (b.unused.empty())
+            {
+                b.all.push_back(std::make_unique< detail::Block >());
+                this->block = b.all.back().get();
+            } else {
+                this->block = b.unused.back();
+                b.unused.pop_back();
+            }
+        }
+        ~Owner()
+        {
+            Blocks& b(blocks());
+            std::lock_guard< std::mutex > lock(b.mutex);
+            b.unused.push_back(this->block);
+        }
+    };
+}
+
+detail::Block& detail::acquire_block()
+{
+    static thread_local Owner owner;
+    return *owner.block;
+}
+
+bool xtypes::instrumentation::enabled()
+{
+    return true;
+}
+
+std::uint64_t xtypes::instrumentation::count(const Counter counter)
+{
+    Blocks& b(blocks());
+    std::lock_guard< std::mutex > lock(b.mutex);
+    std::uint64_t result = 0;
+    for (const auto& block : b.all)
+        result += block->counters[static_cast< std::size_t >(counter)].load(std::memory_order_relaxed);
+    return result;
+}
+
+Histogram xtypes::instrumentation::histogram(const Timer timer)
+{
+    const std::size_t t = static_cast< std::size_t >(timer);
+    Blocks& b(blocks());
+    std::lock_guard< std::mutex > lock(b.mutex);
+    Histogram result;
+    for (const auto& block : b.all)
+    {
+        result.total_ns += block->total_ns[t].load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < n_buckets; ++i)
+            result.buckets[i] += block->buckets[t][i].load(std::memory_order_relaxed);
+    }
+    for (const std::uint64_t n : result.buckets)
+        result.count += n;
+    return result;
+}
+
+nl::json xtypes::instrumentation::snapshot()
+{
+    nl::json result;
+    result["enabled"] = true;
+    result["counters"] = nl::json::object();
+    for (std::size_t c = 0; c < static_cast< std::size_t >(Counter::N_COUNTERS); ++c)
+        result["counters"][Counter2Str[c]] = count(static_cast< Counter >(c));
+    result["timers"] = nl::json::object();
+    for (std::size_t t = 0; t < static_cast< std::size_t >(Timer::N_TIMERS); ++t)
+        result["timers"][Timer2Str[t]] = histogram(static_cast< Timer >(t)).to_json();
+    return result;
+}
+
+void xtypes::instrumentation::reset()
+{
+    Blocks& b(blocks());
+    std::lock_guard< std::mutex > lock(b.mutex);
+    for (const auto& block : b.all)
+    {
+        for (auto& value : block->counters)
+            value.store(0, std::memory_order_relaxed);
+        for (auto& value : block->total_ns)
+            value.store(0, std::memory_order_relaxed);
+        for (auto& buckets : block->buckets)
+            for (auto& value : buckets)
+                value.store(0, std::memory_order_relaxed);
+    }
+}
+#else
+bool xtypes::instrumentation::enabled()
+{
+    return false;
+}
+
+std::uint64_t xtypes::instrumentation::count(const Counter)
+{
+    return 0;
+}
+
+Histogram xtypes::instrumentation::histogram(const Timer)
+{
+    return Histogram();
+}
+
+nl::json xtypes::instrumentation::snapshot()
+{
+    return {{"enabled", false}, {"counters", nl::json::object()}, {"timers", nl::json::object()}};
+}
+
+void xtypes::instrumentation::reset()
+{
+}
+#endif
@@ -0,0 +1,175 @@
+#include "RegistrySnapshot.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace xtypes;
+
+static const std::string snapshot_magic("XTSNAP");
+static const std::uint8_t snapshot_version = 1;
+static const std::size_t snapshot_header_size = 8;
+static const std::size_t snapshot_footer_size = 24;
+
+namespace {
+    void write_uint(std::ofstream& file, std::uint64_t value, const std::size_t n_bytes)
+    {
+        char bytes[8];
+        for (std::size_t i = 0; i < n_bytes; ++i, value >>= 8)
+            bytes[i] = static_cast< char >(value & 0xff);
+        file.write(bytes, n_bytes);
+    }
+}
+
+RegistrySnapshot::Writer::Writer(const std::string& path) : file(path, std::ios::binary | std::ios::trunc)
+{
+    if (!this->file)
+        throw std::runtime_error("RegistrySnapshot::Writer: Cannot open " + path);
+    this->file.write(snapshot_magic.data(), snapshot_magic.size());
+    write_uint(this->file, snapshot_version, 1);
+    write_uint(this->file, 0, 1);
+    this->offset = snapshot_header_size;
+}
+
+void RegistrySnapshot::Writer::add(const nl::json& record)
+{
+    const std::string& uri(record.at("uri").get_ref<const std::string&>());
+    // Only keep what XType::import_from() needs
+    nl::json relations = nl::json::object();
+    for (const auto& [rel_name, entries] : record.at("relations").items())
+    {
+        nl::json& facts(relations[rel_name]);
+        facts = nl::json::array();
+        for (const auto& entry : entries)
+            facts.push_back({{"target", entry.at("target")}, {"edge_properties", entry.at("edge_properties")}});
+    }
+    const std::vector< std::uint8_t > encoded(nl::json::to_msgpack({{"uri", uri},
+                                                                    {"classname", record.at("classname")},
+                                                                    {"properties", record.at("properties")},
+                                                                    {"relations", std::move(relations)}}));
+    this->entries.emplace_back(uri_to_uuid(uri, UuidScheme::CRC32), this->offset);
+    write_uint(this->file, uri.size(), 4);
+    this->file.write(uri.data(), uri.size());
+    write_uint(this->file, encoded.size(), 4);
+    this->file.write(reinterpret_cast< const char* >(encoded.data()), encoded.size());
+    this->offset += 8 + uri.size() + encoded.size();
+}
+
+void RegistrySnapshot::Writer::finish()
+{
+    // Open addressing with a load factor below 1/2
+    std::uint64_t n_buckets = 16;
+    while (n_buckets < 2 * this->entries.size())
+        n_buckets *= 2;
+    std::vector< std::pair< std::uint64_t, std::uint64_t > > buckets(n_buckets, {0, 0});
+    for (const auto& [hash, record_offset] : this->entries)
+    {
+        std::uint64_t i = hash & (n_buckets - 1);
+        while (buckets[i].second != 0)
+            i = (i + 1) & (n_buckets - 1);
+        buckets[i] = {hash, record_offset + 1};
+    }
+    for (const auto& [hash, record_offset] : buckets)
+    {
+        write_uint(this->file, hash, 8);
+        write_uint(this->file, record_offset, 8);
+    }
+    write_uint(this->file, this->offset, 8);
+    write_uint(this->file, n_buckets, 8);
+    write_uint(this->file, this->entries.size(), 8);
+    this->file.close();
+    if (!this->file)
+        throw std::runtime_error("RegistrySnapshot::Writer: Could not write the snapshot");
+    this->entries.clear();
+}
+
+RegistrySnapshot::RegistrySnapshot(const std::string& path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("RegistrySnapshot: Cannot open " + path);
+    struct stat info;
+    if ((::fstat(fd, &info) != 0) || (static_cast< std::size_t >(info.st_size) < snapshot_header_size + snapshot_footer_size))
+    {
+        ::close(fd);
+        throw std::runtime_error("RegistrySnapshot: " + path + " is not a snapshot");
+    }
+    void* mapped = ::mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // NOTE: The mapping stays valid after closing the file
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        throw std::runtime_error("RegistrySnapshot: Cannot map " + path);
+    this->data = static_cast< const std::uint8_t* >(mapped);
+    this->data_size = info.st_size;
+
+    if (!std::equal(snapshot_magic.begin(), snapshot_magic.end(), this->data) || (this->data[snapshot_magic.size()] != snapshot_version))
+    {
+        ::munmap(mapped, this->data_size);
+        throw std::runtime_error("RegistrySnapshot: " + path + " is not a snapshot of version " + std::to_string(snapshot_version));
+    }
+    const std::size_t footer = this->data_size - snapshot_footer_size;
+    this->index_offset = this->read_uint(footer, 8);
+    this->n_buckets = this->read_uint(footer + 8, 8);
+    this->n_records = this->read_uint(footer + 16, 8);
+    if ((this->index_offset + 16 * this->n_buckets != footer) || (this->n_buckets & (this->n_buckets - 1)) || (this->n_buckets == 0))
+    {
+        ::munmap(mapped, this->data_size);
+        throw std::runtime_error("RegistrySnapshot: " + path + " has an invalid index");
+    }
+}
+
+RegistrySnapshot::~RegistrySnapshot()
+{
+    ::munmap(const_cast< std::uint8_t* >(this->data), this->data_size);
+}
+
+std::uint64_t RegistrySnapshot::read_uint(const std::uint64_t offset, const std::size_t n_bytes) const
+{
+    if (offset + n_bytes > this->data_size)
+        throw std::runtime_error("RegistrySnapshot: Truncated snapshot");
+    std::uint64_t value = 0;
+    for (std::size_t i = n_bytes; i > 0; --i)
+        value = (value << 8) | this->data[offset + i - 1];
+    return value;
+}
+
+std::uint64_t RegistrySnapshot::locate(const std::string& uri) const
+{
+    const std::uint64_t hash = uri_to_uuid(uri, UuidScheme::CRC32);
+    for (std::uint64_t i = hash & (this->n_buckets - 1);; i = (i + 1) & (this->n_buckets - 1))
+    {
+        const std::uint64_t bucket = this->index_offset + 16 * i;
+        const std::uint64_t record_offset = this->read_uint(bucket + 8, 8);
+        if (record_offset == 0)
+            return 0;
+        if (this->read_uint(bucket, 8) != hash)
+            continue;
+        // Compare the uri stored in front of the record
+        const std::uint64_t uri_size = this->read_uint(record_offset - 1, 4);
+        if ((uri_size == uri.size()) && (record_offset + 3 + uri_size <= this->data_size)
+            && (std::memcmp(this->data + record_offset + 3, uri.data(), uri_size) == 0))
+            return record_offset - 1;
+    }
+}
+
+bool RegistrySnapshot::contains(const std::string& uri) const
+{
+    return this->locate(uri) != 0;
+}
+
+nl::json RegistrySnapshot::find(const std::string& uri) const
+{
+    const std::uint64_t record_offset = this->locate(uri);
+    if (record_offset == 0)
+        return nullptr;
+    const std::uint64_t encoded_offset = record_offset + 4 + uri.size();
+    const std::uint64_t size = this->read_uint(encoded_offset, 4);
+    if (encoded_offset + 4 + size > this->index_offset)
+        throw std::runtime_error("RegistrySnapshot: Truncated record of " + uri);
+    return nl::json::from_msgpack(this->data + encoded_offset + 4, this->data + encoded_offset + 4 + size);
+}
@@ -0,0 +1,157 @@
+#include "Tracing.hpp"
+#include "XType.hpp"
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using namespace xtypes;
+
+#ifdef XTYPES_INSTRUMENTATION
+namespace {
+    struct Event
+    {
+        const char* name;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point end;
+        std::uint32_t thread;
+        std::string uri;
+        std::string classname;
+        std::string relation;
+    };
+
+    struct Trace
+    {
+        std::mutex mutex;
+        std::string path;
+        std::chrono::steady_clock::time_point origin;
+        std::vector< Event > events;
+    };
+
+    Trace& current_trace()
+    {
+        // NOTE: Intentionally leaked to be usable by spans which end during shutdown
+        static Trace* instance = new Trace();
+        return *instance;
+    }
+
+    /// Small and stable thread ids for the trace viewer
+    std::uint32_t thread_index()
+    {
+        static std::atomic< std::uint32_t > next{1};
+        static thread_local const std::uint32_t index = next++;
+        return index;
+    }
+
+    double microseconds(const std::chrono::steady_clock::duration& duration)
+    {
+        return std::chrono::duration< double, std::micro >(duration).count();
+    }
+}
+
+std::atomic< bool > tracing::detail::running{false};
+
+void tracing::start(const std::string& path)
+{
+    Trace& trace(current_trace());
+    std::lock_guard< std::mutex > lock(trace.mutex);
+    if (detail::running)
+    {
+        throw std::runtime_error("xtypes::tracing::start(): A trace to " + trace.path + " is already running");
+    }
+    trace.path = path;
+    trace.origin = std::chrono::steady_clock::now();
+    trace.events.clear();
+    detail::running = true;
+}
+
+std::size_t tracing::stop()
+{
+    Trace& trace(current_trace());
+    std::vector< Event > events;
+    std::string path;
+    {
+        std::lock_guard< std::mutex > lock(trace.mutex);
+        if (!detail::running)
+            return 0;
+        detail::running = false;
+        events.swap(trace.events);
+        path = trace.path;
+    }
+    nl::json trace_events(nl::json::array());
+    for (const Event& event : events)
+    {
+        nl::json args(nl::json::object());
+        if (!event.uri.empty())
+            args["uri"] = event.uri;
+        if (!event.classname.empty())
+            args["classname"] = event.classname;
+        if (!event.relation.empty())
+            args["relation"] = event.relation;
+        trace_events.push_back({{"name", event.name},
+                                {"cat", "xtypes"},
+                                {"ph", "X"},
+                                {"ts", microseconds(event.start - trace.origin)},
+                                {"dur", microseconds(event.end - event.start)},
+                                {"pid", 1},
+                                {"tid", event.thread},
+                                {"args", std::move(args)}});
+    }
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+    {
+        throw std::runtime_error("xtypes::tracing::stop(): Could not write " + path);
+    }
+    file << nl::json{{"traceEvents", std::move(trace_events)}, {"displayTimeUnit", "ns"}}.dump() << '\n';
+    return events.size();
+}
+
+bool tracing::is_running()
+{
+    return detail::running;
+}
+
+tracing::Span::~Span()
+{
+    if (!this->active)
+        return;
+    const auto end = std::chrono::steady_clock::now();
+    Trace& trace(current_trace());
+    std::lock_guard< std::mutex > lock(trace.mutex);
+    // The trace might have been stopped (and another one started) in the meantime
+    if (!detail::running || (this->start < trace.origin))
+        return;
+    trace.events.push_back({this->name, this->start, end, thread_index(), std::move(this->uri), std::move(this->classname), std::move(this->relation)});
+}
+
+void tracing::Span::set(const XType& xtype, const std::string& relation)
+{
+    this->classname = xtype.get_classname();
+    this->relation = relation;
+    // NOTE: The uri might depend on facts which are not known yet
+    if (xtype.is_uri_valid())
+        this->uri = xtype.uri();
+}
+
+void tracing::Span::set(const std::string& uri, const std::string& classname, const std::string& relation)
+{
+    this->uri = uri;
+    this->classname = classname;
+    this->relation = relation;
+}
+#else
+void tracing::start(const std::string&)
+{
+    throw std::runtime_error("xtypes::tracing::start(): xtypes has been built without XTYPES_INSTRUMENTATION");
+}
+
+std::size_t tracing::stop()
+{
+    return 0;
+}
+
+bool tracing::is_running()
+{
+    return false;
+}
+#endif
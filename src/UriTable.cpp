@@ -0,0 +1,123 @@
+#include "UriTable.hpp"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+using namespace xtypes;
+
+UriHandle UriTable::find(const std::string& uri) const
+{
+    if (this->buckets.empty())
+        return npos;
+    return this->find(uri, std::hash<std::string>{}(uri));
+}
+
+UriHandle UriTable::find(const std::string& uri, const std::size_t hash) const
+{
+    const std::size_t bucket = this->find_bucket(uri, hash);
+    return (bucket < this->buckets.size()) ? this->buckets[bucket] : npos;
+}
+
+std::size_t UriTable::find_bucket(const std::string& uri, const std::size_t hash) const
+{
+    if (this->buckets.empty())
+        return 0;
+    const std::size_t mask = this->buckets.size() - 1;
+    for (std::size_t i = hash & mask; this->buckets[i] != npos; i = (i + 1) & mask)
+    {
+        const UriHandle candidate = this->buckets[i];
+        if ((candidate != tombstone) && (this->hashes[candidate] == hash) && (this->uris[candidate] == uri))
+            return i;
+    }
+    return this->buckets.size();
+}
+
+UriHandle UriTable::intern(const std::string& uri)
+{
+    return this->intern(uri, std::hash<std::string>{}(uri));
+}
+
+UriHandle UriTable::intern(const std::string& uri, const std::size_t hash)
+{
+    const UriHandle existing = this->find(uri, hash);
+    if (existing != npos)
+        return existing;
+    if (this->free_handles.empty() && (this->uris.size() >= static_cast<std::size_t>(tombstone)))
+        throw std::length_error("UriTable::intern(): Too many uris");
+    // Keep the load factor of the hash table (including tombstones) below 1/2
+    if (2 * (this->used_buckets + 1) > this->buckets.size())
+    {
+        // If mostly tombstones fill the table, rehashing at the same size is enough to get rid of them
+        const std::size_t n_buckets = (4 * (this->size() + 1) > this->buckets.size()) ? 2 * this->buckets.size() : this->buckets.size();
+        this->rehash(std::max< std::size_t >(16, n_buckets));
+    }
+    UriHandle handle;
+    if (this->free_handles.empty())
+    {
+        handle = static_cast<UriHandle>(this->uris.size());
+        this->uris.push_back(uri);
+        this->hashes.push_back(hash);
+    }
+    else
+    {
+        handle = this->free_handles.back();
+        this->free_handles.pop_back();
+        this->uris[handle] = uri;
+        this->hashes[handle] = hash;
+    }
+    const std::size_t mask = this->buckets.size() - 1;
+    std::size_t i = hash & mask;
+    while ((this->buckets[i] != npos) && (this->buckets[i] != tombstone))
+        i = (i + 1) & mask;
+    if (this->buckets[i] == npos)
+        ++this->used_buckets;
+    this->buckets[i] = handle;
+    return handle;
+}
+
+bool UriTable::erase(const std::string& uri)
+{
+    return this->erase(uri, std::hash<std::string>{}(uri));
+}
+
+bool UriTable::erase(const std::string& uri, const std::size_t hash)
+{
+    const std::size_t bucket = this->find_bucket(uri, hash);
+    if (bucket >= this->buckets.size())
+        return false;
+    const UriHandle handle = this->buckets[bucket];
+    this->buckets[bucket] = tombstone;
+    // Release the memory of the uri
+    std::string().swap(this->uris[handle]);
+    this->free_handles.push_back(handle);
+    return true;
+}
+
+void UriTable::clear()
+{
+    this->uris.clear();
+    this->hashes.clear();
+    this->buckets.clear();
+    this->used_buckets = 0;
+    this->free_handles.clear();
+}
+
+void UriTable::rehash(const std::size_t n_buckets)
+{
+    this->buckets.assign(n_buckets, npos);
+    this->used_buckets = 0;
+    std::vector< bool > is_free(this->hashes.size(), false);
+    for (const UriHandle handle : this->free_handles)
+        is_free[handle] = true;
+    const std::size_t mask = n_buckets - 1;
+    for (std::size_t handle = 0; handle < this->hashes.size(); ++handle)
+    {
+        if (is_free[handle])
+            continue;
+        std::size_t i = this->hashes[handle] & mask;
+        while (this->buckets[i] != npos)
+            i = (i + 1) & mask;
+        this->buckets[i] = static_cast<UriHandle>(handle);
+        ++this->used_buckets;
+    }
+}
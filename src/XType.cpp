@@ -1,29 +1,356 @@
 #include "XType.hpp"
 #include "XTypeRegistry.hpp"
+#include "BinaryFormat.hpp"
+#include "Instrumentation.hpp"
+#include "Tracing.hpp"
 #include <iostream>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
 #include "utils.hpp"
 
 using namespace xtypes;
 
+namespace {
+    // Source of uri revisions. Revisions are unique among all XTypes, so a replaced fact target can never match an old revision
+    std::atomic< std::uint64_t > next_uri_revision{1};
+
+    /// The XTypes whose uri might have changed after it had been built, in the order of the changes (see XType::uri_changes_since())
+    /// Only the most recent changes are kept in a ring. The epoch of a change is its position in the whole sequence
+    /// NOTE: Changes are appended without a lock. Every entry is a seqlock, so readers detect entries which are still written or have been overwritten
+    struct UriChangeLog
+    {
+        static constexpr std::size_t capacity = 1 << 16;
+
+        struct Entry
+        {
+            // The epoch of the change + 1 (0 while it is written)
+            std::atomic< std::uint64_t > sequence{0};
+            std::atomic< const XType* > xtype{nullptr};
+        };
+        std::unique_ptr< Entry[] > entries{new Entry[capacity]};
+        // The epoch of the next change
+        std::atomic< std::uint64_t > end{0};
+
+        void add(const XType* xtype)
+        {
+            const std::uint64_t epoch(end.fetch_add(1));
+            Entry& entry(entries[epoch % capacity]);
+            // NOTE: The operations are sequentially consistent, so a reader which sees the same sequence before and after reading xtype has read the right one
+            entry.sequence.store(0);
+            entry.xtype.store(xtype);
+            entry.sequence.store(epoch + 1);
+        }
+
+        /// Reads the change at epoch. Returns false if it is not (or no longer) available
+        bool get(const std::uint64_t epoch, const XType*& xtype) const
+        {
+            const Entry& entry(entries[epoch % capacity]);
+            if (entry.sequence.load() != epoch + 1)
+                return false;
+            xtype = entry.xtype.load();
+            return entry.sequence.load() == epoch + 1;
+        }
+    };
+
+    UriChangeLog& uri_change_log()
+    {
+        static UriChangeLog log;
+        return log;
+    }
+
+    // Returns true if the two property paths refer to the same property or one is contained in the other
+    bool property_paths_overlap(const std::string& a, const std::string& b)
+    {
+        const std::size_t n = std::min(a.size(), b.size());
+        if (a.compare(0, n, b, 0, n) != 0)
+            return false;
+        return (a.size() == b.size()) || (a.size() > n && a[n] == '/') || (b.size() > n && b[n] == '/');
+    }
+
+    // The definitions shared among all instances of a class by (classname, level of the constructor) as interned names
+    std::mutex class_schemata_mutex;
+    std::map< std::pair< xtypes::NameId, xtypes::NameId >, std::shared_ptr< const ClassSchema > > class_schemata;
+
+    // The definitions of an XType which has not defined anything yet
+    const std::shared_ptr< const ClassSchema >& empty_class_schema()
+    {
+        static const std::shared_ptr< const ClassSchema > empty(std::make_shared< ClassSchema >());
+        return empty;
+    }
+}
+
 // Static identifier
 const std::string xtypes::XType::classname = "xtypes::XType";
 
 xtypes::XType::XType(const std::string &classname)
-    : m_classname(classname.empty() ? typeid(this).name() : classname)
+    : m_classname_id(intern_name(classname.empty() ? typeid(this).name() : classname)), m_classname(&name_of(m_classname_id)), schema(empty_class_schema())
 {
+    uri_cache.owner = this;
     // NOTE: A pointer to the registry is given when instantiated from the registry OR when we add a valid instance
 }
 
-std::string xtypes::XType::get_classname() const noexcept
+const std::string& xtypes::XType::get_classname() const noexcept
 {
-    return m_classname;
+    return *m_classname;
+}
+
+xtypes::NameId xtypes::XType::get_classname_id() const noexcept
+{
+    return m_classname_id;
 }
 
 std::string xtypes::XType::uri() const
+{
+    // NOTE: The lock is not held while we ask the fact targets for their revisions or call build_uri(), because both might lock other caches or call uri() again
+    std::unique_lock< std::mutex > lock(uri_cache.mutex);
+    // NOTE: Copies of the cache do not know their owner until they are used
+    uri_cache.owner = this;
+    const bool was_valid(uri_cache.valid);
+    const std::uint64_t generation(uri_cache.generation);
+    const std::string cached(was_valid ? uri_cache.uri : std::string());
+    const std::vector< std::uint64_t > seen(uri_cache.target_revisions);
+    lock.unlock();
+    const std::vector< std::uint64_t > current(current_target_revisions());
+    if (was_valid && (current == seen))
+    {
+        XTYPES_COUNT(URI_CACHE_HITS);
+        return cached;
+    }
+    XTYPES_COUNT(URI_BUILDS);
+    // NOTE: If build_uri() throws, the cache stays invalid
+    std::string fresh;
+    try {
+        XTYPES_TIME(BUILD_URI);
+        fresh = build_uri();
+    } catch (...) {
+        lock.lock();
+        if (uri_cache.generation == generation)
+            uri_cache.failed = true;
+        throw;
+    }
+    lock.lock();
+    // If the cache has been invalidated or replaced in the meantime, our uri might be outdated already, so we do not publish it
+    if (uri_cache.generation != generation)
+        return fresh;
+    if (uri_cache.failed)
+    {
+        // Facts might have been indexed while we had no uri (see FactList)
+        uri_change_log().add(this);
+        uri_cache.failed = false;
+    }
+    if ((uri_cache.revision == 0) || (fresh != uri_cache.uri))
+    {
+        uri_cache.revision = next_uri_revision++;
+    }
+    uri_cache.uuid = xtypes::uri_to_uuid(fresh);
+    uri_cache.uri = std::move(fresh);
+    // Remember the state of all fact targets we depend on
+    uri_cache.target_revisions = current;
+    uri_cache.valid = true;
+    return uri_cache.uri;
+}
+
+std::string xtypes::XType::build_uri() const
 {
     return std::string("xtypes://generic");
 }
 
+const std::set<std::string>& xtypes::XType::get_uri_properties() const
+{
+    static const std::set<std::string> none;
+    return none;
+}
+
+const std::set<std::string>& xtypes::XType::get_uri_relations() const
+{
+    static const std::set<std::string> none;
+    return none;
+}
+
+std::vector< std::uint64_t > xtypes::XType::current_target_revisions() const
+{
+    // The uri might also be built from the uris of fact targets, which can change without us noticing
+    // So uri() compares their current revisions with the ones it has seen when building the uri
+    std::vector< std::uint64_t > revisions;
+    for (const auto& name : get_uri_relations())
+    {
+        const auto it = this->facts->find(name);
+        if (it == this->facts->end())
+            continue;
+        for (const auto& fact : it->second)
+        {
+            const XTypePtr target(fact.target.lock());
+            revisions.push_back(target ? target->uri_revision() : 0U);
+        }
+    }
+    return revisions;
+}
+
+void xtypes::XType::invalidate_uri() const
+{
+    std::lock_guard< std::mutex > lock(uri_cache.mutex);
+    if (uri_cache.valid)
+    {
+        uri_change_log().add(this);
+    }
+    uri_cache.valid = false;
+    uri_cache.generation++;
+}
+
+std::uint64_t xtypes::XType::uri_epoch()
+{
+    return uri_change_log().end.load();
+}
+
+bool xtypes::XType::uri_changes_since(std::uint64_t& epoch, std::vector< const XType* >& changed)
+{
+    const UriChangeLog& log(uri_change_log());
+    const std::uint64_t end(log.end.load());
+    for (; epoch < end; ++epoch)
+    {
+        const XType* xtype;
+        if (log.get(epoch, xtype))
+        {
+            changed.push_back(xtype);
+            continue;
+        }
+        // The change has either been overwritten already or is still being written. In the latter case, we stop before it
+        if (log.end.load() - epoch > UriChangeLog::capacity)
+        {
+            epoch = end;
+            return false;
+        }
+        break;
+    }
+    return true;
+}
+
+xtypes::XType::UriCache::UriCache(const UriCache& other)
+{
+    std::lock_guard< std::mutex > lock(other.mutex);
+    valid = other.valid;
+    failed = other.failed;
+    uri = other.uri;
+    uuid = other.uuid;
+    revision = other.revision;
+    target_revisions = other.target_revisions;
+}
+
+xtypes::XType::UriCache& xtypes::XType::UriCache::operator=(const UriCache& other)
+{
+    if (this == &other)
+        return *this;
+    std::scoped_lock lock(mutex, other.mutex);
+    // NOTE: Assigning another XType might change our uri. If we do not know our owner, the log tells that some uri has changed
+    // Assigning the same valid uri (e.g. on every commit) changes nothing, so it is not logged
+    if (valid && (!other.valid || (other.uri != uri)))
+    {
+        uri_change_log().add(owner);
+    }
+    generation++;
+    valid = other.valid;
+    failed = other.failed;
+    uri = other.uri;
+    uuid = other.uuid;
+    revision = other.revision;
+    target_revisions = other.target_revisions;
+    return *this;
+}
+
+void xtypes::XType::property_changed(const std::string& path_to_key)
+{
+    this->changes.properties = true;
+    this->list_changes();
+    const std::string key((!path_to_key.empty() && path_to_key.front() == '/') ? path_to_key.substr(1) : path_to_key);
+    for (const auto& uri_property : get_uri_properties())
+    {
+        if (property_paths_overlap(key, uri_property))
+        {
+            invalidate_uri();
+            return;
+        }
+    }
+}
+
+void xtypes::XType::facts_changed(const std::string& name)
+{
+    if (!this->changes.all)
+    {
+        this->changes.relations.insert(name);
+    }
+    this->list_changes();
+    if (get_uri_relations().count(name) > 0)
+    {
+        invalidate_uri();
+    }
+}
+
+void xtypes::XType::list_changes()
+{
+    if (this->change_listing.listed || !this->has_changes())
+        return;
+    XTypeRegistryPtr reg = this->registry.lock();
+    // NOTE: In the constructor there is neither a registry nor a shared pointer to us
+    const XTypeWeakPtr self(this->weak_from_this());
+    if (!reg || self.expired())
+        return;
+    this->change_listing.listed = true;
+    reg->track_change(self);
+}
+
+bool xtypes::XType::has_changes() const
+{
+    return this->changes.all || this->changes.properties || !this->changes.relations.empty();
+}
+
+std::set<std::string> xtypes::XType::get_changed_relations() const
+{
+    if (!this->changes.all)
+        return this->changes.relations;
+    std::set<std::string> result;
+    for (const auto &[rel_name, fs] : *this->facts)
+        result.insert(rel_name);
+    return result;
+}
+
+void xtypes::XType::clear_changes()
+{
+    this->changes = ChangeSet();
+    this->changes.all = false;
+    this->change_listing.listed = false;
+}
+
+nl::json xtypes::XType::export_changes_record() const
+{
+    nl::json record(this->export_record());
+    if (this->changes.all)
+        return record;
+    nl::json& relations(record["relations"]);
+    for (auto it = relations.begin(); it != relations.end();)
+    {
+        if (this->changes.relations.count(it.key()))
+            ++it;
+        else
+            it = relations.erase(it);
+    }
+    return record;
+}
+
+std::uint64_t xtypes::XType::uri_revision() const
+{
+    try {
+        uri();
+    } catch (...) {
+        return 0U;
+    }
+    std::lock_guard< std::mutex > lock(uri_cache.mutex);
+    return uri_cache.revision;
+}
+
 bool xtypes::XType::is_uri_valid() const
 {
     try {
@@ -36,7 +363,12 @@ bool xtypes::XType::is_uri_valid() const
 
 std::size_t xtypes::XType::uuid() const
 {
-    return xtypes::uri_to_uuid(uri());
+    const std::string current(uri());
+    std::lock_guard< std::mutex > lock(uri_cache.mutex);
+    // NOTE: If uri() has been overridden, the cache might not be in use
+    if (uri_cache.valid && current == uri_cache.uri)
+        return uri_cache.uuid;
+    return xtypes::uri_to_uuid(current);
 }
 
 /// Sets the registry of the XType if not already set
@@ -45,13 +377,20 @@ void XType::set_registry_once(XTypeRegistryCPtr reg)
     if (registry.expired())
     {
         registry = reg;
+        change_listing.listed = false;
+        list_changes();
     }
 }
 
 /// Overwrite the registry
 void XType::overwrite_registry(XTypeRegistryCPtr reg)
 {
+    if (registry.lock() != reg)
+    {
+        change_listing.listed = false;
+    }
     registry = reg;
+    list_changes();
 }
 
 /// Returns the registry of this XType if set. Otherwise nullptr
@@ -66,9 +405,207 @@ XTypeRegistryCPtr XType::get_registry() const
 std::map< std::string, nl::json > xtypes::XType::export_to(const int max_depth)
 {
     std::map< std::string, nl::json > result;
+    this->export_to_writer([&result](const std::string& uri, const nl::json& record) { result[uri] = record; }, max_depth);
+    return result;
+}
+
+namespace {
+    // Same as XType::ExportEncoder
+    using Encoder = std::function< void(const nl::json& record, std::string& encoded) >;
+
+    /// What the exports need to serialize a visited XType (taken during the traversal, so it can be serialized by any thread)
+    struct ExportItem
+    {
+        std::string uri;
+        std::size_t uuid;
+        const std::string* classname;
+        // NOTE: Shared with the XType, modifications of the XType do not change it
+        CopyOnWrite< nl::json > properties;
+        struct ExportedRelation
+        {
+            std::string name;
+            bool dir_forward;
+            std::string delete_policy;
+            PinnedFacts facts;
+        };
+        std::vector< ExportedRelation > relations;
+        // The uris of the targets of all facts in the order of relations
+        std::vector< std::string > target_uris;
+        // The serialization and its encoding (if any)
+        nl::json record;
+        std::string encoded;
+    };
+
+    void serialize(ExportItem& item, const Encoder& encode)
+    {
+        nl::json& record(item.record);
+        record["properties"] = *item.properties;
+        record["uri"] = item.uri;
+        record["uuid"] = std::to_string(item.uuid);
+        record["classname"] = *item.classname;
+        record["relations"] = nl::json::object();
+        std::size_t i = 0;
+        for (const auto& rel : item.relations)
+        {
+            nl::json& entries(record["relations"][rel.name]);
+            entries = nl::json::array();
+            for (const auto& f : rel.facts)
+            {
+                nl::json entry;
+                entry["target"] = item.target_uris[i++];
+                entry["edge_properties"] = f.edge_properties;
+                entry["delete_policy"] = rel.delete_policy;
+                entry["relation_dir_forward"] = rel.dir_forward;
+                entries.push_back(entry);
+            }
+        }
+        if (encode)
+        {
+            encode(record, item.encoded);
+            // Only the encoding is emitted, so we free the record while it is still in the cache
+            record = nl::json();
+        }
+    }
+
+    /// Threads which process ranges of independent items (e.g. the chunks of an export) in parallel
+    /// They live as long as this object and the calling thread helps them
+    class Workers
+    {
+    public:
+        explicit Workers(const std::size_t n_threads)
+        : n_workers(std::max< std::size_t >(n_threads, 1)), errors(n_workers)
+        {
+            for (std::size_t worker = 1; worker < n_workers; ++worker)
+                threads.emplace_back(&Workers::run, this, worker);
+        }
+
+        ~Workers()
+        {
+            {
+                std::lock_guard< std::mutex > lock(mutex);
+                stopping = true;
+            }
+            started.notify_all();
+            for (auto& thread : threads)
+                thread.join();
+        }
+
+        /// Calls f(i) for all i < n (every worker takes a contiguous part). Blocks until all are done
+        /// If calls throw, the exception of the lowest i is rethrown
+        void for_each(const std::size_t n, const std::function< void(const std::size_t) >& f)
+        {
+            if (n == 0)
+                return;
+            {
+                std::lock_guard< std::mutex > lock(mutex);
+                n_items = n;
+                func = &f;
+                n_busy = n_workers - 1;
+                generation++;
+            }
+            started.notify_all();
+            process(0);
+            {
+                std::unique_lock< std::mutex > lock(mutex);
+                finished.wait(lock, [this]() { return n_busy == 0; });
+            }
+            // NOTE: The parts are in the order of the workers, so the first error is the one of the lowest item
+            std::exception_ptr first;
+            for (auto& error : errors)
+            {
+                if (error && !first)
+                    first = error;
+                error = nullptr;
+            }
+            if (first)
+                std::rethrow_exception(first);
+        }
+
+    private:
+        void run(const std::size_t worker)
+        {
+            std::size_t seen = 0;
+            while (true)
+            {
+                {
+                    std::unique_lock< std::mutex > lock(mutex);
+                    started.wait(lock, [this, seen]() { return stopping || (generation != seen); });
+                    if (stopping)
+                        return;
+                    seen = generation;
+                }
+                process(worker);
+                {
+                    std::lock_guard< std::mutex > lock(mutex);
+                    if (--n_busy == 0)
+                        finished.notify_one();
+                }
+            }
+        }
+
+        void process(const std::size_t worker)
+        {
+            try {
+                const std::size_t begin(n_items * worker / n_workers);
+                const std::size_t end(n_items * (worker + 1) / n_workers);
+                for (std::size_t i = begin; i < end; ++i)
+                    (*func)(i);
+            } catch (...) {
+                errors[worker] = std::current_exception();
+            }
+        }
+
+        const std::size_t n_workers;
+        std::vector< std::exception_ptr > errors;
+        std::vector< std::thread > threads;
+        std::mutex mutex;
+        std::condition_variable started;
+        std::condition_variable finished;
+        // The current range, its number and the number of threads which still process parts of it
+        std::size_t n_items = 0;
+        const std::function< void(const std::size_t) >* func = nullptr;
+        std::size_t generation = 0;
+        std::size_t n_busy = 0;
+        bool stopping = false;
+    };
+
+    /// Returns the number of threads to use for a requested number (0 means one per hardware thread)
+    std::size_t thread_count(const std::size_t n_threads)
+    {
+        return n_threads ? n_threads : std::max(std::thread::hardware_concurrency(), 1U);
+    }
+}
+
+std::size_t xtypes::XType::export_to_writer(const ExportWriter& writer, const int max_depth)
+{
+    // NOTE: Chunks of a single XType pass every record on as soon as it has been visited
+    return this->export_chunked(1, 1, max_depth, nullptr, [&writer](const std::string& uri, const nl::json& record, const std::string&) { writer(uri, record); });
+}
+
+std::size_t xtypes::XType::export_to_writer_parallel(const ExportWriter& writer, const std::size_t n_threads, const int max_depth)
+{
+    const std::size_t n(thread_count(n_threads));
+    return this->export_chunked(n, n * export_chunk_size, max_depth, nullptr, [&writer](const std::string& uri, const nl::json& record, const std::string&) { writer(uri, record); });
+}
+
+std::size_t xtypes::XType::export_chunked(const std::size_t n_threads, const std::size_t chunk_size, const int max_depth, const ExportEncoder& encode, const ExportEmitter& emit)
+{
+    XTYPES_TRACE("XType::export_to", *this);
+    // NOTE: Instead of the whole result we only remember which xtypes have already been handled
+    std::unordered_set< std::string > visited;
     XTypeRegistryCPtr reg = this->registry.lock();
     // This queue stores all XTypes which have to be visited at a certain depth
     std::deque<std::pair<unsigned, XTypePtr>> to_visit = {{0U, shared_from_this()}};
+    // The visited XTypes which still have to be serialized
+    std::vector< ExportItem > chunk;
+    Workers workers(n_threads);
+    const std::function< void(const std::size_t) > serialize_item([&chunk, &encode](const std::size_t i) { serialize(chunk[i], encode); });
+    auto flush = [&]() {
+        workers.for_each(chunk.size(), serialize_item);
+        for (const auto& item : chunk)
+            emit(item.uri, item.record, item.encoded);
+        chunk.clear();
+    };
     while (to_visit.size() > 0)
     {
         // Get the current xtype to be visited
@@ -76,7 +613,7 @@ std::map< std::string, nl::json > xtypes::XType::export_to(const int max_depth)
         to_visit.pop_front();
         const std::string xtype_uri = xtype->uri();
         // Check if the current xtype has already been handled
-        if (result.count(xtype_uri) > 0)
+        if (!visited.insert(xtype_uri).second)
             continue;
         // Commit that xtype to the registry (if available)
         // We HAVE TO overwrite existing models (because references, properties and/or URI's could have changed)
@@ -84,52 +621,226 @@ std::map< std::string, nl::json > xtypes::XType::export_to(const int max_depth)
         {
             reg->commit(xtype, true);
         }
-        // Place xtype into result set
-        result[xtype_uri]["properties"] = xtype->get_properties();
-        result[xtype_uri]["uri"] = xtype_uri;
-        result[xtype_uri]["uuid"] = std::to_string(xtype->uuid());
-        result[xtype_uri]["classname"] = xtype->get_classname();
-        result[xtype_uri]["relations"] = nl::json::object();
+        // Remember what has to be serialized
+        // NOTE: The traversal modifies XTypes (e.g. by resolving facts), so it stays in this thread
+        ExportItem& item(chunk.emplace_back());
+        item.uri = xtype_uri;
+        item.uuid = xtype->uuid();
+        item.classname = xtype->m_classname;
+        item.properties = xtype->properties;
         // Check if we explore further or not
-        if ((max_depth >= 0) && (depth >= max_depth))
-            continue;
-        // Resolve relations
-        const auto &rels(xtype->get_relations());
-        for (const auto &[rel_name, rel] : rels)
-        {
-            // Check if there are facts to export or not
-            // NOTE: This can happen if we have partially loaded/defined models
-            if (!xtype->has_facts(rel_name))
-                continue;
-            const bool rel_dir_fwd = xtype->get_relations_dir(rel_name);
-            const std::string rel_del_pol = std::string(DeletePolicy2Str[static_cast<int>(rel.delete_policy)]);
-            result[xtype_uri]["relations"][rel_name] = nl::json::array();
-            const auto &fs(xtype->get_facts(rel_name));
-            for (const auto &f : fs)
+        if ((max_depth < 0) || (depth < static_cast<unsigned>(max_depth)))
+        {
+            // Resolve relations
+            const auto &rels(xtype->get_relations());
+            for (const auto &[rel_name, rel] : rels)
             {
-                nl::json entry;
-                const auto &other_xtype = f.target.lock();
-                const auto &rel_props = f.edge_properties;
-                // HINT: assertion may e.g. fail if the instance is not instantiated from or contained by the ProjectRegistry
-                assert(other_xtype.get());
-                const std::string other_uri = other_xtype->uri();
-                entry["target"] = other_uri;
-                entry["edge_properties"] = rel_props;
-                entry["delete_policy"] = rel_del_pol;
-                entry["relation_dir_forward"] = rel_dir_fwd;
-                result[xtype_uri]["relations"][rel_name].push_back(entry);
-                // Check if we already visited it
-                if (result.count(other_uri) > 0)
+                // Check if there are facts to export or not
+                // NOTE: This can happen if we have partially loaded/defined models
+                if (!xtype->has_facts(rel_name))
                     continue;
-                // Register new xtype to be visited
-                to_visit.push_back({depth + 1, other_xtype});
+                ExportItem::ExportedRelation& exported(item.relations.emplace_back());
+                exported.name = rel_name;
+                exported.dir_forward = xtype->get_relations_dir(rel_name);
+                exported.delete_policy = DeletePolicy2Str[static_cast<int>(rel.delete_policy)];
+                exported.facts = xtype->get_facts(rel_name);
+                // NOTE: get_facts() holds the targets, so they stay alive until the chunk has been written (even if the registry does not hold them)
+                for (const XTypePtr &other_xtype : exported.facts.targets)
+                {
+                    assert(other_xtype.get());
+                    const std::string& other_uri(item.target_uris.emplace_back(other_xtype->uri()));
+                    // Check if we already visited it
+                    if (visited.count(other_uri) > 0)
+                        continue;
+                    // Register new xtype to be visited
+                    to_visit.push_back({depth + 1, other_xtype});
+                }
             }
         }
+        if (chunk.size() >= chunk_size)
+            flush();
     }
-    return result;
+    flush();
+    return visited.size();
+}
+
+std::size_t xtypes::XType::export_to_stream(std::ostream& stream, const int max_depth)
+{
+    return this->export_to_writer([&stream](const std::string&, const nl::json& record) { stream << record.dump() << '\n'; }, max_depth);
+}
+
+std::size_t xtypes::XType::export_to_stream_parallel(std::ostream& stream, const std::size_t n_threads, const int max_depth)
+{
+    // The records are dumped concurrently as well
+    const std::size_t n(thread_count(n_threads));
+    return this->export_chunked(n, n * export_chunk_size, max_depth,
+                                [](const nl::json& record, std::string& encoded) { encoded = record.dump(); },
+                                [&stream](const std::string&, const nl::json&, const std::string& encoded) { stream << encoded << '\n'; });
+}
+
+std::vector< std::uint8_t > xtypes::XType::export_binary(const int max_depth)
+{
+    BinaryGraphWriter writer;
+    this->export_to_writer([&writer](const std::string&, const nl::json& record) { writer.add(record); }, max_depth);
+    return writer.finish();
+}
+
+XTypeCPtr xtypes::XType::import_binary(const std::vector< std::uint8_t >& data, XTypeRegistryCPtr reg)
+{
+    if (!reg)
+    {
+        throw std::runtime_error("xtypes::Xtype::import_binary(): no registry given");
+    }
+    const BinaryGraphReader reader(data);
+    if (reader.size() == 0)
+        return nullptr;
+    commit_records(reader, reg);
+    return reg->get_by_uri(reader.at(0)["uri"].get<std::string>());
+}
+
+std::size_t xtypes::XType::commit_records(const BinaryGraphReader& reader, XTypeRegistryCPtr reg)
+{
+    std::vector< XTypePtr > instances;
+    instances.reserve(reader.size());
+    for (std::size_t i = 0; i < reader.size(); ++i)
+    {
+        XTypePtr instance(build_from(reader.at(i), reg));
+        if (instance)
+            instances.push_back(instance);
+    }
+    // We overwrite any existing entity with the new info
+    return reg->commit_many(instances, true);
+}
+
+nl::json xtypes::XType::export_record() const
+{
+    nl::json record;
+    record["properties"] = this->get_properties();
+    record["uri"] = this->uri();
+    record["uuid"] = std::to_string(this->uuid());
+    record["classname"] = this->get_classname();
+    record["relations"] = nl::json::object();
+    for (const auto &[rel_name, rel] : this->get_relations())
+    {
+        // NOTE: UNKNOWN facts are not exported (see export_to_writer())
+        const auto it = this->facts->find(rel_name);
+        if (it == this->facts->end())
+            continue;
+        const bool rel_dir_fwd = this->get_relations_dir(rel_name);
+        const std::string rel_del_pol = std::string(DeletePolicy2Str[static_cast<int>(rel.delete_policy)]);
+        nl::json& entries(record["relations"][rel_name]);
+        entries = nl::json::array();
+        for (const auto &f : it->second)
+        {
+            nl::json entry;
+            entry["target"] = f.target_uri();
+            entry["edge_properties"] = f.edge_properties;
+            entry["delete_policy"] = rel_del_pol;
+            entry["relation_dir_forward"] = rel_dir_fwd;
+            entries.push_back(entry);
+        }
+    }
+    return record;
 }
 
 XTypeCPtr xtypes::XType::import_from(const nl::json& spec, XTypeRegistryCPtr reg)
+{
+    XTYPES_TRACE("XType::import_from", spec.is_object() ? spec.value("uri", "") : "", spec.is_object() ? spec.value("classname", "") : "");
+    XTypePtr result(build_from(spec, reg));
+    if (!result)
+        return nullptr;
+    // We now commit() and return a temporary copy with get_by_uri().
+    // We overwrite any existing entity with the new info
+    reg->commit(result, true);
+    return reg->get_by_uri(result->uri());
+}
+
+xtypes::ImportStats xtypes::XType::import_from_stream(std::istream& stream, XTypeRegistryCPtr reg, const std::streamoff offset, const ImportProgress& progress, const std::size_t batch_size, const std::size_t n_threads)
+{
+    using Clock = std::chrono::steady_clock;
+    if (!reg)
+    {
+        throw std::runtime_error("xtypes::Xtype::import_from_stream(): no registry given");
+    }
+    ImportStats stats;
+    stats.offset = offset;
+    if (offset > 0)
+    {
+        stream.seekg(offset);
+        if (!stream)
+            throw std::runtime_error("xtypes::Xtype::import_from_stream(): Cannot seek to offset " + std::to_string(offset));
+    }
+    const auto start = Clock::now();
+    // Only the current batch is kept in memory: The offsets and lines of its records and the XTypes built from them
+    std::vector< std::pair< std::streamoff, std::string > > lines;
+    lines.reserve(std::max<std::size_t>(batch_size, 1));
+    std::vector< XTypePtr > batch;
+    std::streamoff next_offset = offset;
+    // The records of a batch are parsed and instantiated concurrently
+    Workers workers(thread_count(n_threads));
+    const std::function< void(const std::size_t) > build_line([&lines, &batch, &reg](const std::size_t i) {
+        nl::json spec;
+        try {
+            spec = nl::json::parse(lines[i].second);
+        } catch (const nl::json::parse_error& e) {
+            throw std::runtime_error("xtypes::Xtype::import_from_stream(): Invalid record at offset " + std::to_string(lines[i].first) + ": " + e.what());
+        }
+        batch[i] = build_from(spec, reg);
+    });
+    auto flush = [&]() {
+        batch.assign(lines.size(), nullptr);
+        workers.for_each(lines.size(), build_line);
+        lines.clear();
+        // Empty records have not been instantiated
+        const auto skipped = std::remove(batch.begin(), batch.end(), nullptr);
+        stats.n_skipped += std::distance(skipped, batch.end());
+        batch.erase(skipped, batch.end());
+        stats.n_imported += reg->commit_many(batch, true);
+        batch.clear();
+        // Everything up to here has been committed, so an import can be resumed from this offset
+        stats.offset = next_offset;
+        stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (progress)
+            progress(stats);
+    };
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        const std::streamoff line_offset = next_offset;
+        next_offset += line.size() + (stream.eof() ? 0 : 1);
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        lines.emplace_back(line_offset, std::move(line));
+        if (lines.size() >= batch_size)
+            flush();
+    }
+    flush();
+    return stats;
+}
+
+xtypes::ImportStats xtypes::XType::import_many(const std::vector< nl::json >& specs, XTypeRegistryCPtr reg, const std::size_t n_threads)
+{
+    using Clock = std::chrono::steady_clock;
+    if (!reg)
+    {
+        throw std::runtime_error("xtypes::Xtype::import_many(): no registry given");
+    }
+    const auto start = Clock::now();
+    std::vector< XTypePtr > instances(specs.size());
+    Workers workers(thread_count(n_threads));
+    workers.for_each(specs.size(), [&specs, &instances, &reg](const std::size_t i) { instances[i] = build_from(specs[i], reg); });
+    ImportStats stats;
+    // Empty records have not been instantiated
+    const auto skipped = std::remove(instances.begin(), instances.end(), nullptr);
+    stats.n_skipped = std::distance(skipped, instances.end());
+    instances.erase(skipped, instances.end());
+    // We overwrite any existing entity with the new info
+    stats.n_imported = reg->commit_many(instances, true);
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return stats;
+}
+
+XTypePtr xtypes::XType::build_from(const nl::json& spec, XTypeRegistryCPtr reg)
 {
     // Check if URI exists
     if (spec.empty())
@@ -196,39 +907,28 @@ XTypeCPtr xtypes::XType::import_from(const nl::json& spec, XTypeRegistryCPtr reg
             continue;
         // Initialize KNOWN fact entry (could still be EMPTY though)
         result->set_unknown_fact_empty(rel_name);
-        for (const auto &entry : relation_spec[rel_name])
+        const nl::json &entries(relation_spec[rel_name]);
+        FactList &fs(result->facts.mutate()[rel_name]);
+        fs.reserve(fs.size() + entries.size());
+        for (const auto &entry : entries)
         {
             const std::string &other_uri(entry["target"]);
-            const nl::json &props(entry["edge_properties"]);
-            // Check if properties match the schema
-            nl::json updated_props;
-            nl::json flattened = rel.property_schema.property_types.flatten();
-            for (const auto& [k,v] : flattened.items())
-            {
-                if (k.empty()) continue;
-                nl::json::json_pointer jptr(PropertySchema::to_pointer(k));
-                if (props.contains(jptr) && rel.property_schema.is_type_matching(k, props.at(jptr)) && rel.property_schema.is_allowed_value(k, props.at(jptr)))
-                    updated_props[jptr] = props.at(jptr);
-                else
-                    updated_props[jptr] = rel.property_schema.default_values.at(jptr);
-            }
             // NOTE: Here we cannot load the other xtype by URI! Otherwise we would trigger a full load of the whole (sub)graph
             // That means, that we cannot use add_fact() but have to add a raw fact
-            ExtendedFact new_fact(other_uri, updated_props);
             // TODO: Check if already existent?
             // TODO: Check for cardinality constraints?
-            result->facts[rel_name].push_back(new_fact);
+            fs.emplace_back(other_uri, rel.property_schema.validated_values(entry["edge_properties"]));
         }
+        result->facts_changed(rel_name);
     }
     // Make sure that the resulting xtype gets into _valid_instances of the registry
     if (!result->is_uri_valid())
     {
         throw std::runtime_error("xtypes::XType::import_from(): Could not import a valid xtype from spec. URI is invalid");
     }
-    // We now commit() and return a temporary copy with get_by_uri().
-    // We overwrite any existing entity with the new info
-    reg->commit(result, true);
-    return reg->get_by_uri(result->uri());
+    // The imported state is the persisted one
+    result->clear_changes();
+    return result;
 }
 
 void xtypes::XType::define_property(const std::string& path_to_key,
@@ -237,38 +937,89 @@ void xtypes::XType::define_property(const std::string& path_to_key,
                      const nl::json& default_value,
                      const bool& override)
 {
-    this->property_schema.define_property(path_to_key, type, allowed_values, default_value, override);
+    this->mutable_schema().property_schema.define_property(path_to_key, type, allowed_values, default_value, override);
     // Make sure that the key exists in properties (type has already been checked before)
-    this->properties[PropertySchema::to_pointer(path_to_key)] = default_value;
+    this->mutable_properties()[PropertySchema::to_pointer(path_to_key)] = default_value;
+    // The slots might have changed, so we have to resolve them again
+    this->property_slots.values.clear();
+    this->property_changed(path_to_key);
+}
+
+ClassSchema& xtypes::XType::mutable_schema()
+{
+    // Copy-on-write: Never modify definitions which are in use by other instances
+    if (this->schema.use_count() > 1)
+    {
+        this->schema = std::make_shared< ClassSchema >(*this->schema);
+    }
+    return const_cast< ClassSchema& >(*this->schema);
+}
+
+bool xtypes::XType::adopt_class_schema(const std::string& level)
+{
+    std::shared_ptr< const ClassSchema > shared;
+    {
+        std::lock_guard< std::mutex > lock(class_schemata_mutex);
+        const auto it = class_schemata.find({this->m_classname_id, this->level_id(level)});
+        if (it == class_schemata.end())
+            return false;
+        shared = it->second;
+    }
+    this->schema = shared;
+    this->properties = shared->default_properties;
+    this->property_slots.values.clear();
+    this->invalidate_uri();
+    return true;
+}
+
+void xtypes::XType::share_class_schema(const std::string& level)
+{
+    this->mutable_schema().default_properties = this->properties;
+    std::lock_guard< std::mutex > lock(class_schemata_mutex);
+    // NOTE: If another instance has been faster, we keep its definitions (they are the same)
+    class_schemata.emplace(std::make_pair(this->m_classname_id, this->level_id(level)), this->schema);
+}
+
+xtypes::NameId xtypes::XType::level_id(const std::string& level) const
+{
+    // Most constructors are the ones of the final class, so we can avoid interning
+    return (level == *this->m_classname) ? this->m_classname_id : intern_name(level);
 }
 
 bool xtypes::XType::has_property(const std::string& path_to_key) const
 {
-    return this->property_schema.has_property(path_to_key);
+    return this->schema->property_schema.has_property(path_to_key);
 }
 
 nl::json::value_t xtypes::XType::get_property_type(const std::string& path_to_key) const
 {
-    return this->property_schema.get_property_type(path_to_key);
+    return this->schema->property_schema.get_property_type(path_to_key);
 }
 
 std::set<nl::json> xtypes::XType::get_allowed_property_values(const std::string& path_to_key) const
 {
-    return this->property_schema.get_allowed_property_values(path_to_key);
+    return this->schema->property_schema.get_allowed_property_values(path_to_key);
 }
 
 bool xtypes::XType::is_allowed_value(const std::string& path_to_key, const nl::json& value) const
 {
-    return this->property_schema.is_allowed_value(path_to_key, value);
+    return this->schema->property_schema.is_allowed_value(path_to_key, value);
 }
 
 bool xtypes::XType::is_type_matching(const std::string& path_to_key, const nl::json &value) const
 {
-    return this->property_schema.is_type_matching(path_to_key, value);
+    return this->schema->property_schema.is_type_matching(path_to_key, value);
 }
 
 void xtypes::XType::set_property(const std::string& path_to_key, const nl::json &new_value, const bool shall_throw)
 {
+    // Fast path: The key refers to a (leaf) property with a compiled slot
+    const std::size_t slot = this->schema->property_schema.find_slot(path_to_key);
+    if (slot != PropertySchema::npos)
+    {
+        this->set_property_slot(slot, new_value, shall_throw);
+        return;
+    }
     // Check if the property has been defined
     if (!this->has_property(path_to_key))
     {
@@ -300,32 +1051,121 @@ void xtypes::XType::set_property(const std::string& path_to_key, const nl::json
         }
         return;
     }
-    this->properties[PropertySchema::to_pointer(path_to_key)] = new_value;
+    this->mutable_properties()[PropertySchema::to_pointer(path_to_key)] = new_value;
+    // NOTE: Assigning an intermediate key replaces the values below it
+    this->property_slots.values.clear();
+    this->property_changed(path_to_key);
+}
+
+void xtypes::XType::set_property_by_key(const PropertyKey& key, const nl::json &new_value, const bool shall_throw)
+{
+    const std::size_t slot = this->schema->property_schema.find_slot(key);
+    if (slot == PropertySchema::npos)
+    {
+        this->set_property(key.key, new_value, shall_throw);
+        return;
+    }
+    this->set_property_slot(slot, new_value, shall_throw);
+}
+
+void xtypes::XType::set_property_slot(const std::size_t slot, const nl::json &new_value, const bool shall_throw)
+{
+    const PropertySlot& info(this->schema->property_schema.get_slots()[slot]);
+    // We should not be able to change the type here, so we check it
+    if (shall_throw && info.type == nl::json::value_t::discarded)
+    {
+        std::cerr << this->get_classname() + "::set_property: No type defined for property " + info.key + ". Type safety isn't assured." << std::endl;
+    }
+    else if (!PropertySchema::is_type_matching(info.type, new_value)) // handle empty dict
+    {
+        if (shall_throw)
+        {
+            throw std::invalid_argument(this->get_classname() + "::set_property: Property " + info.key + ": Type mismatch. " +
+                                        "Expected " + value_t2string.at(info.type) + ", but received " + value_t2string.at(new_value.type()));
+        }
+        return;
+    }
+    else if (!PropertySchema::is_allowed_value(info.allowed_values, new_value))
+    {
+        if (shall_throw)
+        {
+            throw std::invalid_argument(this->get_classname() + "::set_property: Value " + new_value.dump() + " not allowed for property " + info.key);
+        }
+        return;
+    }
+    // NOTE: The slot cache only hands out const pointers, but this instance is not const here (and the properties are not shared anymore)
+    this->mutable_properties();
+    const_cast<nl::json&>(this->get_property_slot(slot)) = new_value;
+    this->property_changed(info.key);
 }
 
 nl::json xtypes::XType::get_property(const std::string& path_to_key) const
 {
+    // Fast path: The key refers to a (leaf) property with a compiled slot
+    const std::size_t slot = this->schema->property_schema.find_slot(path_to_key);
+    if (slot != PropertySchema::npos)
+    {
+        return this->get_property_slot(slot);
+    }
     if (!this->has_property(path_to_key))
     {
         throw std::invalid_argument(this->get_classname() + "::get_property: Property " + path_to_key + " not found.");
     }
-    return this->properties.at(PropertySchema::to_pointer(path_to_key));
+    return this->properties->at(PropertySchema::to_pointer(path_to_key));
+}
+
+const nl::json& xtypes::XType::get_property_by_key(const PropertyKey& key) const
+{
+    const std::size_t slot = this->schema->property_schema.find_slot(key);
+    if (slot == PropertySchema::npos)
+    {
+        // NOTE: Intermediate keys of nested properties have no slot
+        if (!this->schema->property_schema.property_types.contains(key.pointer))
+        {
+            throw std::invalid_argument(this->get_classname() + "::get_property_by_key: Property " + key.key + " not found.");
+        }
+        return this->properties->at(key.pointer);
+    }
+    return this->get_property_slot(slot);
+}
+
+const nl::json& xtypes::XType::get_property_slot(const std::size_t slot) const
+{
+    const std::vector< PropertySlot >& slots(this->schema->property_schema.get_slots());
+    if (this->property_slots.values.size() != slots.size())
+    {
+        this->property_slots.values.assign(slots.size(), nullptr);
+    }
+    const nl::json*& value(this->property_slots.values[slot]);
+    if (!value)
+    {
+        value = &this->properties->at(slots[slot].pointer);
+    }
+    return *value;
 }
 
 nl::json xtypes::XType::get_properties() const
 {
-    return this->properties;
+    return *this->properties;
+}
+
+nl::json& xtypes::XType::mutable_properties()
+{
+    // The cached pointers refer to the shared properties, not to our copy
+    if (this->properties.is_shared())
+    {
+        this->property_slots.values.clear();
+    }
+    return this->properties.mutate();
 }
 
 void xtypes::XType::set_properties(const nl::json &properties, const bool shall_throw)
 {
-    nl::json flattened(this->property_schema.property_types.flatten());
-    for (const auto &[k,v] : flattened.items())
+    const std::vector< PropertySlot >& slots(this->schema->property_schema.get_slots());
+    for (std::size_t slot = 0; slot < slots.size(); ++slot)
     {
-        if (k.empty()) continue;
-        nl::json::json_pointer jptr(k);
-        if (properties.contains(jptr))
-            set_property(k, properties.at(jptr), shall_throw);
+        if (properties.contains(slots[slot].pointer))
+            this->set_property_slot(slot, properties.at(slots[slot].pointer), shall_throw);
     }
 }
 
@@ -344,31 +1184,32 @@ void xtypes::XType::define_relation(const std::string& name,
     {
         std::swap(from_classnames, to_classnames);
     }
-    Relation relation = {
-        relation_type,
-        super_relation_type,
-        from_classnames,
-        to_classnames,
-        constraint,
-        delpolicy,
-        property_schema};
+    Relation relation;
+    relation.relation_type = relation_type;
+    relation.subrelation_of = super_relation_type;
+    relation.from_classnames = std::move(from_classnames);
+    relation.to_classnames = std::move(to_classnames);
+    relation.constraint = constraint;
+    relation.delete_policy = delpolicy;
+    relation.property_schema = property_schema;
 
     // Bind relation definition to name and store the direction of the facts/relation instances
     // Also initialize empty list in facts
     if (!this->has_relation(name) || override)
     {
-        this->relations[name] = relation;
-        this->relation_dir_forward[name] = !inverse;
+        ClassSchema& definitions(this->mutable_schema());
+        definitions.relations[name] = relation;
+        definitions.relation_dir_forward[name] = !inverse;
         // NOTE: We do NOT create empty facts here, because we do not know if the user wants to define an XType only partially
     }
     else
     {
-        const xtypes::Relation &existing_relation = this->relations[name];
+        const xtypes::Relation &existing_relation = this->schema->relations.at(name);
         if (existing_relation != relation)
         {
             throw std::invalid_argument(this->get_classname() + "::define_relation: A different relation for " + name + " already exists!");
         }
-        bool existing_direction = this->relation_dir_forward[name];
+        bool existing_direction = this->schema->relation_dir_forward.at(name);
         if (existing_direction != inverse)
         {
             throw std::invalid_argument(this->get_classname() + "::define_relation: A different relation direction has already been defined for " + name);
@@ -378,30 +1219,31 @@ void xtypes::XType::define_relation(const std::string& name,
 
 bool xtypes::XType::has_relation(const std::string &name) const
 {
-    if (this->relations.count(name) > 0)
+    if (this->schema->relations.count(name) > 0)
         return true;
     return false;
 }
 
 // Returns all the currently defined relations on the XType
-std::map<std::string, Relation> xtypes::XType::get_relations() const
+const std::map<std::string, Relation>& xtypes::XType::get_relations() const
 {
-    return this->relations;
+    return this->schema->relations;
 }
 
-Relation xtypes::XType::get_relation(const std::string &name) const
+const Relation& xtypes::XType::get_relation(const std::string &name) const
 {
     if (!this->has_relation(name))
         throw std::invalid_argument(this->get_classname() + "::get_relation: No relation on " + name + " not defined");
-    return this->relations.at(name);
+    return this->schema->relations.at(name);
 }
 
 // Get the direction in which the attribute gets filled with dependent XType(s)
 bool xtypes::XType::get_relations_dir(const std::string &name) const
 {
-    if (relation_dir_forward.find(name) == relation_dir_forward.end())
+    const auto it = this->schema->relation_dir_forward.find(name);
+    if (it == this->schema->relation_dir_forward.end())
         throw std::invalid_argument(this->get_classname() + "::get_relations_dir: Could not find relation direction for " + name);
-    return relation_dir_forward.at(name);
+    return it->second;
 }
 
 /* Facts Interface (Facts are Instances of Relations) */
@@ -410,7 +1252,7 @@ bool xtypes::XType::has_facts(const std::string &name) const
 {
     if (!this->has_relation(name))
         throw std::invalid_argument(this->get_classname() + "::has_facts: No relation definition found for " + name);
-    if (this->facts.count(name) > 0)
+    if (this->facts->count(name) > 0)
         return true;
     return false;
 }
@@ -420,22 +1262,23 @@ void xtypes::XType::set_unknown_fact_empty(const std::string& name)
 {
     if (this->has_relation(name) && !this->has_facts(name))
     {
-      this->facts[name] = std::vector<ExtendedFact>{};
+      this->facts.mutate()[name] = FactList();
+      this->facts_changed(name);
     }
 }
 
 /// Initializes all UNKNOWN facts to be KNOWN and EMPTY
 void xtypes::XType::set_all_unknown_facts_empty()
 {
-    for (const auto& it : this->relations)
+    for (const auto& it : this->schema->relations)
     {
         this->set_unknown_fact_empty(it.first);
     }
 }
 
-const std::vector<Fact> xtypes::XType::get_facts(const std::string &name)
+const PinnedFacts xtypes::XType::get_facts(const std::string &name)
 {
-    std::vector<Fact> result;
+    PinnedFacts result;
     if (!this->has_facts(name))
     {
         throw std::runtime_error(this->get_classname() + "::get_facts("+name+"): Facts unknown");
@@ -446,13 +1289,55 @@ const std::vector<Fact> xtypes::XType::get_facts(const std::string &name)
     // If we don't, but have a valid target_uri, we ask the registry to get us that thing
     // In that case, we also want to store that pointer in our private facts (that's why get_facts() is not const anymore)
     // Furthermore, we need to do what add_fact() does and auto-fill any matching inverse relation to the new XType
-    for (auto& fact : this->facts.at(name))
+    // If several facts have to be resolved, we ask the registry for all of them at once
+    // Fast path: Nothing to resolve or update, so we do not have to modify (and maybe copy) our facts
+    // The result holds the targets, so the caller can use them even if neither we nor the registry hold them
+    const FactList& current(this->facts->at(name));
+    if (std::all_of(current.begin(), current.end(), [](const ExtendedFact& fact) { return !fact.target.expired() && fact.is_target_uri_current(); }))
     {
-        if (!fact.target.expired())
+        result.reserve(current.size());
+        result.targets.reserve(current.size());
+        for (const auto& fact : current)
+        {
+            result.push_back(fact);
+            result.targets.push_back(fact.target.lock());
+        }
+        if (std::find(result.targets.begin(), result.targets.end(), nullptr) == result.targets.end())
+            return result;
+        // A target expired in the meantime, so we have to resolve it after all
+        result.clear();
+        result.targets.clear();
+    }
+    XTYPES_TRACE("XType::get_facts", *this, name);
+    std::map<std::string, XTypePtr> preloaded;
+    std::vector<std::string> resolved_uris;
+    XTypeRegistryPtr batch_reg = registry.lock();
+    if (batch_reg)
+    {
+        std::vector<std::string> unresolved;
+        for (const auto& fact : current)
+        {
+            if (fact.target.expired() && !fact.target_uri().empty())
+                unresolved.push_back(fact.target_uri());
+        }
+        if (unresolved.size() > 1)
+        {
+            const std::vector<XTypePtr> loaded(batch_reg->load_many(unresolved));
+            for (std::size_t i = 0; i < unresolved.size(); ++i)
+                preloaded[unresolved[i]] = loaded[i];
+        }
+    }
+    FactList& fs(this->facts.mutate().at(name));
+    for (auto fact_it = fs.begin(); fact_it != fs.end(); ++fact_it)
+    {
+        const ExtendedFact& fact(*fact_it);
+        if (XTypePtr alive = fact.target.lock())
         {
             // Update target uri
-            fact.target_uri(fact.target_uri());
+            if (!fact.is_target_uri_current())
+                fs.update(fact_it.get_slot(), [](ExtendedFact& f) { f.target_uri(f.target_uri()); });
             result.push_back(fact);
+            result.targets.push_back(std::move(alive));
             continue;
         }
         // We do not have a valid target (yet)
@@ -468,42 +1353,75 @@ const std::vector<Fact> xtypes::XType::get_facts(const std::string &name)
         {
             throw std::runtime_error(this->get_classname() + "::get_facts("+name+"): No registry");
         }
-        // We have an uri, so we ask the registry to resolve this
-        XTypeCPtr other = reg->load_by_uri(fact.target_uri());
+        // We have an uri, so we ask the registry to resolve this (unless we already did)
+        const auto it = preloaded.find(fact.target_uri());
+        XTypeCPtr other = (it != preloaded.end()) ? it->second : reg->load_by_uri(fact.target_uri());
         if (!other)
         {
             // TODO: Throw or skip?
             throw std::runtime_error(this->get_classname() + "::get_facts("+name+"): Registry could not resolve " + fact.target_uri());
         }
-        // Store that pointer back
-        fact.target = other;
-        // Update target uri
-        fact.target_uri(fact.target_uri());
+        resolved_uris.push_back(fact.target_uri());
+        // Store that pointer back and update target uri
+        fs.update(fact_it.get_slot(), [&other](ExtendedFact& f) {
+            f.target = other;
+            f.target_uri(f.target_uri());
+        });
         result.push_back(fact);
+        result.targets.push_back(other);
 
         // Auto-fill a matching inverse relation
-        const Relation our_rel = this->get_relation(name);
-        const bool our_forward = this->get_relations_dir(name);
-        // Try to find a matching relation at other
-        const std::map<std::string, Relation> &other_relations(other->get_relations());
-        for (const auto &[other_name, other_rel] : other_relations)
-        {
-            // If relation directions are the same, they cannot match (the other has to be in the opposite dir)
-            const bool other_forward(other->get_relations_dir(other_name));
-            if (our_forward == other_forward)
-            {
-                continue;
-            }
-            // Check if relation definitions match
-            if (our_rel != other_rel)
-            {
-                continue;
-            }
-            // We found a match, so we auto-fill the other
-            other->add_fact(other_name, shared_from_this(), fact.edge_properties);
-        }
+        this->add_inverse_facts(name, other, fact.edge_properties);
+    }
+
+    // Speculatively resolve the neighbours of the targets we just resolved
+    if (batch_reg && !resolved_uris.empty())
+    {
+        batch_reg->prefetch(resolved_uris, batch_reg->get_prefetch_depth());
     }
+    return result;
+}
 
+std::future< PinnedFacts > xtypes::XType::get_facts_async(const std::string &name)
+{
+    if (!this->has_facts(name))
+    {
+        throw std::runtime_error(this->get_classname() + "::get_facts_async("+name+"): Facts unknown");
+    }
+    // Issue the loads of all pending targets now ...
+    std::vector<std::string> unresolved;
+    for (const auto& fact : this->facts->at(name))
+    {
+        if (fact.target.expired() && !fact.target_uri().empty())
+            unresolved.push_back(fact.target_uri());
+    }
+    std::shared_future< std::vector<XTypePtr> > loads;
+    XTypeRegistryPtr reg = registry.lock();
+    if (reg && !unresolved.empty())
+    {
+        loads = reg->load_many_async(unresolved).share();
+    }
+    // ... but store the results in our facts in the thread which waits for them (XTypes are not synchronized)
+    XTypePtr self(shared_from_this());
+    return std::async(std::launch::deferred, [self, name, loads]() {
+        if (loads.valid())
+            loads.wait();
+        return self->get_facts(name);
+    });
+}
+
+std::vector<std::string> xtypes::XType::get_unresolved_uris() const
+{
+    std::vector<std::string> result;
+    for (const auto &[name, fs] : *this->facts)
+    {
+        for (const auto& fact : fs)
+        {
+            // NOTE: An expired target stays expired, so target_uri() will not touch it
+            if (fact.target.expired() && !fact.target_uri().empty())
+                result.push_back(fact.target_uri());
+        }
+    }
     return result;
 }
 
@@ -517,22 +1435,9 @@ void xtypes::XType::add_fact(const std::string &name, XTypeCPtr other, const nl:
         throw std::invalid_argument(this->get_classname() + "::add_fact("+name+"): Given xtype ptr is invalid");
     }
 
-    // use default relation properties and update it by given properties
+    // use default relation properties and update it by given properties (if they match the schema)
     const Relation &rel(this->get_relation(name));
-    // Check if properties match the schema
-    nl::json updated_props;
-    nl::json flattened = rel.property_schema.property_types.flatten();
-    for (const auto& [k,v] : flattened.items())
-    {
-        if (k.empty()) continue;
-        nl::json::json_pointer jptr(PropertySchema::to_pointer(k));
-        if (props.contains(jptr) && rel.property_schema.is_type_matching(k, props.at(jptr)) && rel.property_schema.is_allowed_value(k, props.at(jptr)))
-        {
-            updated_props[jptr] = props.at(jptr);
-        } else {
-            updated_props[jptr] = rel.property_schema.default_values.at(jptr);
-        }
-    }
+    const nl::json updated_props(rel.property_schema.validated_values(props));
 
     // Check if we already have facts
     const bool have_facts(this->has_facts(name));
@@ -544,18 +1449,23 @@ void xtypes::XType::add_fact(const std::string &name, XTypeCPtr other, const nl:
     if (have_facts)
     {
         // If fact is already known, update edge properties
-        auto existing_fact = std::find(facts.at(name).begin(), facts.at(name).end(), new_fact);
-        if (existing_fact != facts.at(name).end())
+        const std::size_t slot = this->find_fact(name, new_fact);
+        if (slot != FactList::npos)
         {
             fact_already_exists = true;
             // Always update target uri
             // NOTE: If we dont do this, an (now) valid fact stays invalid
-            existing_fact->target_uri(existing_fact->target_uri());
+            // NOTE: We only modify (and maybe copy) our facts if something changes
+            if (!this->facts->at(name).get(slot).is_target_uri_current())
+            {
+                this->facts.mutate().at(name).update(slot, [](ExtendedFact& f) { f.target_uri(f.target_uri()); });
+            }
             // Check if properties have changed
-            if (existing_fact->edge_properties != updated_props)
+            if (this->facts->at(name).get(slot).edge_properties != updated_props)
             {
-                existing_fact->edge_properties = updated_props;
+                this->facts.mutate().at(name).update(slot, [&updated_props](ExtendedFact& f) { f.edge_properties = updated_props; });
                 properties_changed = true;
+                this->facts_changed(name);
             }
         }
 
@@ -582,14 +1492,32 @@ void xtypes::XType::add_fact(const std::string &name, XTypeCPtr other, const nl:
                 constraint = Constraint::ONE2MANY;
         }
         // Check cardinality constraints
-        if (((constraint == Constraint::MANY2ONE) || (constraint == Constraint::ONE2ONE)) && have_facts && (this->facts.at(name).size() > 0))
+        if (((constraint == Constraint::MANY2ONE) || (constraint == Constraint::ONE2ONE)) && have_facts && (this->facts->at(name).size() > 0))
             throw std::length_error(this->get_classname() + "::add_fact("+name+"): Cardinality constraint on does not allow adding another fact");
-        this->facts[name].push_back(new_fact);
+        this->facts.mutate()[name].push_back(std::move(new_fact));
+        this->facts_changed(name);
     }
 
     // Auto-fill a matching inverse relation
     // NOTE: This has to be done in both cases (new fact or modified fact)
-    const Relation our_rel = this->get_relation(name);
+    this->add_inverse_facts(name, other, updated_props);
+}
+
+void xtypes::XType::add_inverse_facts(const std::string &name, XTypeCPtr &other, const nl::json &props)
+{
+    // The registry knows the matching relations of registered classes in advance
+    XTypeRegistryPtr reg = this->registry.lock();
+    if (const std::vector<std::string>* matches = reg ? reg->find_inverse_relations(*this, name, *other) : nullptr)
+    {
+        for (const std::string& other_name : *matches)
+        {
+            XTYPES_COUNT(INVERSE_FILLS);
+            other->add_fact(other_name, shared_from_this(), props);
+        }
+        return;
+    }
+    XTYPES_COUNT(INVERSE_FALLBACKS);
+    const Relation &our_rel(this->get_relation(name));
     const bool our_forward = this->get_relations_dir(name);
     // Try to find a matching relation at other
     const std::map<std::string, Relation> &other_relations(other->get_relations());
@@ -607,10 +1535,24 @@ void xtypes::XType::add_fact(const std::string &name, XTypeCPtr other, const nl:
             continue;
         }
         // We found a match, so we auto-fill the other
-        other->add_fact(other_name, shared_from_this(), updated_props);
+        XTYPES_COUNT(INVERSE_FILLS);
+        other->add_fact(other_name, shared_from_this(), props);
     }
 }
 
+std::size_t xtypes::XType::find_fact(const std::string& name, const ExtendedFact& fact)
+{
+    std::size_t slot = this->facts->at(name).find(fact);
+    // The index might still use outdated uris of some targets
+    if ((slot == FactList::npos) && !this->facts->at(name).is_index_current())
+    {
+        FactList& fs(this->facts.mutate().at(name));
+        fs.refresh();
+        slot = fs.find(fact);
+    }
+    return slot;
+}
+
 void xtypes::XType::remove_fact(const std::string& name, XTypeCPtr other)
 {
     if (!other)
@@ -622,8 +1564,13 @@ void xtypes::XType::remove_fact(const std::string& name, XTypeCPtr other)
         return;
     }
     ExtendedFact to_be_removed(other, {});
-    auto it = std::remove(this->facts.at(name).begin(), this->facts.at(name).end(), to_be_removed);
-    this->facts.at(name).erase(it, this->facts.at(name).end());
+    // NOTE: We only modify (and maybe copy) our facts if there is something to remove
+    if (this->find_fact(name, to_be_removed) == FactList::npos)
+    {
+        return;
+    }
+    this->facts.mutate().at(name).remove(to_be_removed);
+    this->facts_changed(name);
     // TODO: We have to remove every matching fact from this to other
     // AND also check if an inverse relation exists at other from which this has to be removed
 }
@@ -1,18 +1,142 @@
 #include "XTypeRegistry.hpp"
 #include "XType.hpp"
+#include "BinaryFormat.hpp"
+#include "Instrumentation.hpp"
+#include "Tracing.hpp"
+#include "RegistrySnapshot.hpp"
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <unordered_set>
 
 namespace xtypes {
 
-XTypeRegistry::XTypeRegistry()
+/// Jobs waiting for a bounded number of threads which are started on demand
+struct XTypeRegistry::TaskQueue
 {
+    explicit TaskQueue(const std::size_t max_threads) : max_threads(max_threads) {}
+
+    const std::size_t max_threads;
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::condition_variable idle;
+    std::deque< std::function< void() > > jobs;
+    std::vector< std::thread > threads;
+    // Number of threads which are currently running a job
+    std::size_t n_running = 0;
+    bool stopping = false;
+
+    /// Queues a job unless max_queued jobs are waiting already (0 = no limit). Returns false if the job has been discarded
+    static bool submit(const std::shared_ptr< TaskQueue >& queue, std::function< void() > job, const std::size_t max_queued = 0)
+    {
+        std::lock_guard< std::mutex > lock(queue->mutex);
+        if (queue->stopping || ((max_queued > 0) && (queue->jobs.size() >= max_queued)))
+            return false;
+        queue->jobs.push_back(std::move(job));
+        // Start another thread if all running ones are busy
+        if ((queue->threads.size() < queue->max_threads) && (queue->n_running + queue->jobs.size() > queue->threads.size()))
+            queue->threads.emplace_back(&TaskQueue::run, queue);
+        queue->queued.notify_one();
+        return true;
+    }
+
+    /// Discards the queued jobs and joins the threads
+    static void stop(const std::shared_ptr< TaskQueue >& queue)
+    {
+        std::vector< std::thread > threads;
+        {
+            std::lock_guard< std::mutex > lock(queue->mutex);
+            queue->stopping = true;
+            queue->jobs.clear();
+            threads.swap(queue->threads);
+        }
+        queue->queued.notify_all();
+        queue->idle.notify_all();
+        for (auto& thread : threads)
+        {
+            // If a job has released the last reference to the registry, we are running in its thread
+            if (thread.get_id() == std::this_thread::get_id())
+                thread.detach();
+            else
+                thread.join();
+        }
+    }
+
+    static void run(const std::shared_ptr< TaskQueue > queue)
+    {
+        std::unique_lock< std::mutex > lock(queue->mutex);
+        while (true)
+        {
+            queue->queued.wait(lock, [&queue]() { return queue->stopping || !queue->jobs.empty(); });
+            if (queue->stopping)
+                return;
+            std::function< void() > job(std::move(queue->jobs.front()));
+            queue->jobs.pop_front();
+            queue->n_running++;
+            lock.unlock();
+            // NOTE: The job might release the last reference to the registry, so we must only touch the queue afterwards
+            job();
+            job = nullptr;
+            lock.lock();
+            if ((--queue->n_running == 0) && queue->jobs.empty())
+                queue->idle.notify_all();
+        }
+    }
+};
+
+XTypeRegistry::XTypeRegistry(const std::size_t n_shards)
+: _prefetch_queue(std::make_shared< TaskQueue >(max_prefetch_threads)),
+  _load_queue(std::make_shared< TaskQueue >(max_load_threads))
+{
+    for (std::size_t i = 0; i < std::max< std::size_t >(n_shards, 1); ++i)
+    {
+        _shards.push_back(std::make_unique< Shard >());
+    }
     register_class<XType>();
 }
 
+XTypeRegistry::~XTypeRegistry()
+{
+    TaskQueue::stop(_prefetch_queue);
+    TaskQueue::stop(_load_queue);
+}
+
+const XTypePtr& XTypeRegistry::Shard::valid_instance(const UriHandle handle) const
+{
+    static const XTypePtr none;
+    if (handle >= valid_instances.size())
+        return none;
+    return valid_instances[handle];
+}
+
+UriHandle XTypeRegistry::Shard::insert(const std::string& uri, const std::size_t hash)
+{
+    const UriHandle handle(uris.intern(uri, hash));
+    if (handle >= valid_instances.size())
+    {
+        valid_instances.resize(handle + 1);
+        valid_to_temporary.resize(handle + 1);
+    }
+    return handle;
+}
+
+std::size_t XTypeRegistry::shard_index(const std::size_t hash) const
+{
+    // NOTE: The UriTable of the shard uses the lower bits of the hash, so we use the upper ones here
+    return (hash >> (sizeof(std::size_t) * 4)) % _shards.size();
+}
+
+XTypeRegistry::Shard& XTypeRegistry::shard_of(const std::size_t hash) const
+{
+    return *_shards[shard_index(hash)];
+}
+
 bool XTypeRegistry::register_alias(const std::string& original, const std::string& alias)
 {
-    if (!knows_class(original))
+    std::unique_lock< std::shared_mutex > lock(_factories_mutex);
+    if (!_factories.count(original))
         return false;
-    if (knows_class(alias))
+    if (_factories.count(alias))
         return false;
     _factories[alias] = _factories[original];
     return true;
@@ -20,6 +144,7 @@ bool XTypeRegistry::register_alias(const std::string& original, const std::strin
 
 std::set<std::string> XTypeRegistry::get_classnames() const
 {
+    std::shared_lock< std::shared_mutex > lock(_factories_mutex);
     std::set<std::string> classes;
     for (const auto &[classname, func] : _factories)
     {
@@ -30,6 +155,7 @@ std::set<std::string> XTypeRegistry::get_classnames() const
 
 bool XTypeRegistry::knows_class(const std::string& with_name) const
 {
+    std::shared_lock< std::shared_mutex > lock(_factories_mutex);
     if (_factories.find(with_name) != _factories.end())
         return true;
     return false;
@@ -37,113 +163,410 @@ bool XTypeRegistry::knows_class(const std::string& with_name) const
 
 void XTypeRegistry::import_from(const XTypeRegistry& other)
 {
+    if (&other == this)
+        return;
+    std::unique_lock< std::shared_mutex > lock(_factories_mutex);
+    std::shared_lock< std::shared_mutex > other_lock(other._factories_mutex);
     for (const auto &[classname, func] : other._factories)
     {
-        if (knows_class(classname))
+        if (_factories.count(classname))
             continue;
         _factories[classname] = func;
+        register_inverse_relations(func);
         // TODO: Shall we import instances as well?
     }
 }
 
+namespace {
+    /// Adds the names of the relations of other which match the relations of source inversely to matches
+    void add_inverse_matches(const ClassSchema& source, const ClassSchema& other,
+                             std::map< std::string, std::unordered_map< const ClassSchema*, std::vector< std::string > > >& matches)
+    {
+        for (const auto &[name, rel] : source.relations)
+        {
+            std::vector< std::string >& names(matches[name][&other]);
+            const bool forward(source.relation_dir_forward.at(name));
+            for (const auto &[other_name, other_rel] : other.relations)
+            {
+                // If relation directions are the same, they cannot match (the other has to be in the opposite dir)
+                if ((other.relation_dir_forward.at(other_name) != forward) && (rel == other_rel))
+                    names.push_back(other_name);
+            }
+        }
+    }
+}
+
+void XTypeRegistry::register_inverse_relations(const std::function<UniqueXTypePtr()>& factory)
+{
+    // NOTE: The schema of a prototype is the one shared by all instances of its class (unless the class does not share its schema)
+    const std::shared_ptr< const ClassSchema > schema(factory()->schema);
+    // Aliases and classes without own definitions share the schema of another class
+    if (_inverse_relations.count(schema.get()))
+        return;
+    InverseRelations& added(_inverse_relations[schema.get()]);
+    added.schema = schema;
+    // Match the new class with every registered class (and itself) in both directions
+    // NOTE: Existing entries are never modified, so the pointers returned by find_inverse_relations() stay valid
+    for (auto &[other_schema, other] : _inverse_relations)
+    {
+        add_inverse_matches(*schema, *other_schema, added.matches);
+        if (other_schema != schema.get())
+            add_inverse_matches(*other_schema, *schema, other.matches);
+    }
+}
+
+const std::vector< std::string >* XTypeRegistry::find_inverse_relations(const XType& source, const std::string& name, const XType& other) const
+{
+    std::shared_lock< std::shared_mutex > lock(_factories_mutex);
+    const auto source_it = _inverse_relations.find(source.schema.get());
+    if (source_it == _inverse_relations.end())
+        return nullptr;
+    const auto rel_it = source_it->second.matches.find(name);
+    if (rel_it == source_it->second.matches.end())
+        return nullptr;
+    const auto other_it = rel_it->second.find(other.schema.get());
+    if (other_it == rel_it->second.end())
+        return nullptr;
+    return &other_it->second;
+}
+
 XTypeCPtr XTypeRegistry::instantiate_from(const std::string& classname)
 {
-    if (knows_class(classname))
+    std::function<UniqueXTypePtr()> factory;
     {
-        XTypePtr instance(_factories.at(classname)());
-        // Set the registry to this registry
-        instance->set_registry_once(shared_from_this());
-        _temporary_instances.push_back(instance);
-        return instance;
+        std::shared_lock< std::shared_mutex > lock(_factories_mutex);
+        const auto it = _factories.find(classname);
+        if (it == _factories.end())
+            return nullptr;
+        factory = it->second;
+    }
+    XTypePtr instance(factory());
+    // Set the registry to this registry
+    instance->set_registry_once(shared_from_this());
+    track_temporary(instance);
+    return instance;
+}
+
+void XTypeRegistry::track_temporary(const XTypePtr& instance)
+{
+    std::lock_guard< std::mutex > lock(_temporary_instances_mutex);
+    _temporary_stats.created++;
+    switch (_temporary_policy)
+    {
+        case TemporaryPolicy::STRONG:
+            _temporary_instances.push_back(instance);
+            break;
+        case TemporaryPolicy::WEAK:
+            _weak_temporary_instances.push_back(instance);
+            // Amortized compaction: We only compact if the number of tracked instances has doubled since the last time
+            if (_weak_temporary_instances.size() >= _next_compaction)
+            {
+                compact_weak_temporaries();
+                _next_compaction = std::max< std::size_t >(1024, 2 * _weak_temporary_instances.size());
+            }
+            break;
+        case TemporaryPolicy::KEEP_NONE:
+            break;
     }
-    return nullptr;
+}
+
+void XTypeRegistry::compact_weak_temporaries()
+{
+    const std::size_t n_before = _weak_temporary_instances.size();
+    _weak_temporary_instances.erase(std::remove_if(_weak_temporary_instances.begin(), _weak_temporary_instances.end(),
+                                                   [](const XTypeWeakPtr& instance) { return instance.expired(); }),
+                                    _weak_temporary_instances.end());
+    _temporary_stats.compactions++;
+    _temporary_stats.reclaimed += n_before - _weak_temporary_instances.size();
+}
+
+void XTypeRegistry::set_temporary_policy(const TemporaryPolicy& policy)
+{
+    std::lock_guard< std::mutex > lock(_temporary_instances_mutex);
+    if (policy == _temporary_policy)
+        return;
+    // Take over the instances which are still alive
+    std::vector< XTypePtr > strong;
+    std::vector< XTypeWeakPtr > weak;
+    if (policy == TemporaryPolicy::WEAK)
+    {
+        weak.assign(_temporary_instances.begin(), _temporary_instances.end());
+        weak.insert(weak.end(), _weak_temporary_instances.begin(), _weak_temporary_instances.end());
+    }
+    else if (policy == TemporaryPolicy::STRONG)
+    {
+        strong.swap(_temporary_instances);
+        for (const auto& instance : _weak_temporary_instances)
+        {
+            if (XTypePtr alive = instance.lock())
+                strong.push_back(alive);
+        }
+    }
+    _temporary_instances.swap(strong);
+    _weak_temporary_instances.swap(weak);
+    _next_compaction = std::max< std::size_t >(1024, 2 * _weak_temporary_instances.size());
+    _temporary_policy = policy;
+}
+
+TemporaryPolicy XTypeRegistry::get_temporary_policy() const
+{
+    std::lock_guard< std::mutex > lock(_temporary_instances_mutex);
+    return _temporary_policy;
+}
+
+void XTypeRegistry::compact_temporary_instances()
+{
+    std::lock_guard< std::mutex > lock(_temporary_instances_mutex);
+    compact_weak_temporaries();
+}
+
+TemporaryStats XTypeRegistry::get_temporary_stats() const
+{
+    std::lock_guard< std::mutex > lock(_temporary_instances_mutex);
+    TemporaryStats stats(_temporary_stats);
+    stats.tracked = _temporary_instances.size() + _weak_temporary_instances.size();
+    return stats;
 }
 
 bool XTypeRegistry::knows_uri(const std::string& uri) const
 {
-    if (_valid_instances.count(uri))
+    const std::size_t hash(std::hash<std::string>{}(uri));
+    const Shard& shard(shard_of(hash));
     {
-        return true;
+        std::shared_lock< std::shared_mutex > lock(shard.mutex);
+        if (shard.valid_instance(shard.uris.find(uri, hash)))
+        {
+            return true;
+        }
     }
-    return false;
+    std::shared_ptr< const RegistrySnapshot > snapshot;
+    {
+        std::shared_lock< std::shared_mutex > lock(_factories_mutex);
+        snapshot = _snapshot;
+    }
+    return snapshot && snapshot->contains(uri);
 }
 
 bool XTypeRegistry::commit(XTypeCPtr& instance, const bool overwrite_if_exists)
 {
+    XTYPES_TIME(COMMIT);
+    XTYPES_TRACE("XTypeRegistry::commit", *instance);
     // Check if the instance is valid
     if (!instance->is_uri_valid())
         return false;
     // Store uri
     const std::string uri(instance->uri());
+    const std::size_t hash(std::hash<std::string>{}(uri));
     // Make sure the instance knows us (only if not yet set!)
     instance->set_registry_once(shared_from_this());
+    Shard& shard(shard_of(hash));
+    std::unique_lock< std::shared_mutex > lock(shard.mutex);
+    commit_locked(shard, instance, uri, hash, overwrite_if_exists);
+    return true;
+}
+
+std::size_t XTypeRegistry::commit_many(const std::vector< XTypePtr >& instances, const bool overwrite_if_exists)
+{
+    XTYPES_TIME(COMMIT);
+    XTYPES_TRACE("XTypeRegistry::commit_many", "");
+    // Compute the uris outside of any lock and sort them by shard
+    struct Pending
+    {
+        std::size_t index;
+        std::string uri;
+        std::size_t hash;
+    };
+    std::vector< std::vector< Pending > > by_shard(_shards.size());
+    const XTypeRegistryPtr self(shared_from_this());
+    for (std::size_t i = 0; i < instances.size(); ++i)
+    {
+        if (!instances[i] || !instances[i]->is_uri_valid())
+            continue;
+        std::string uri(instances[i]->uri());
+        const std::size_t hash(std::hash<std::string>{}(uri));
+        instances[i]->set_registry_once(self);
+        by_shard[shard_index(hash)].push_back({i, std::move(uri), hash});
+    }
+    std::size_t n_committed = 0;
+    for (std::size_t s = 0; s < by_shard.size(); ++s)
+    {
+        if (by_shard[s].empty())
+            continue;
+        Shard& shard(*_shards[s]);
+        std::unique_lock< std::shared_mutex > lock(shard.mutex);
+        for (const auto& pending : by_shard[s])
+        {
+            commit_locked(shard, instances[pending.index], pending.uri, pending.hash, overwrite_if_exists);
+            n_committed++;
+        }
+    }
+    return n_committed;
+}
+
+void XTypeRegistry::commit_locked(Shard& shard, XTypeCPtr& instance, const std::string& uri, const std::size_t hash, const bool overwrite_if_exists)
+{
+    XTYPES_COUNT(COMMITS);
+    const UriHandle handle(shard.insert(uri, hash));
+    XTypePtr& valid(shard.valid_instances[handle]);
     // Create a new entry in _valid_instances if not found
-    if (!knows_uri(uri))
+    if (!valid)
     {
         // NOTE: We have to do this manually because it shall not be in _temporary_instances
-        _valid_instances[uri] = _factories.at(instance->get_classname())();
-        *(_valid_instances.at(uri)) = *instance;
+        std::function<UniqueXTypePtr()> factory;
+        {
+            std::shared_lock< std::shared_mutex > factories_lock(_factories_mutex);
+            factory = _factories.at(instance->get_classname());
+        }
+        valid = factory();
+        XTYPES_COUNT(COMMIT_COPIES);
+        *valid = *instance;
+        // NOTE: Changes are tracked on the instances handed out, never on the valid ones
+        valid->clear_changes();
     }
     else if (overwrite_if_exists)
     {
         // Copy the content of instance into _valid_instances
-        *(_valid_instances.at(uri)) = *instance;
-        // If we have a valid copy, we have to update that as well
-        if (_valid_to_temporary.count(uri) && !_valid_to_temporary.at(uri).expired())
+        XTYPES_COUNT(COMMIT_COPIES);
+        *valid = *instance;
+        valid->clear_changes();
+        // The temporary copy might already be in use by others, so we must not overwrite it here.
+        // Instead we forget it and get_by_uri() hands out a fresh copy of the new valid instance
+        // NOTE: If the committed instance is the temporary copy itself, it is up-to-date already
+        if (shard.valid_to_temporary[handle].lock() != instance)
         {
-            *(_valid_to_temporary.at(uri).lock()) = *instance;
+            shard.valid_to_temporary[handle].reset();
         }
     }
     // Make sure the registry of the valid instance is set to us!
-    _valid_instances.at(uri)->overwrite_registry(shared_from_this());
+    valid->overwrite_registry(shared_from_this());
     // NOTE: We do not invalidate any temporary instances or copies of valid instances.
-    return true;
 }
 
 XTypeCPtr XTypeRegistry::get_by_uri(const std::string& uri)
+{
+    XTypePtr result(get_committed(uri));
+    if (!result && materialize(uri))
+    {
+        result = get_committed(uri);
+    }
+    return result;
+}
+
+bool XTypeRegistry::materialize(const std::string& uri)
+{
+    std::shared_ptr< const RegistrySnapshot > snapshot;
+    {
+        std::shared_lock< std::shared_mutex > lock(_factories_mutex);
+        snapshot = _snapshot;
+    }
+    if (!snapshot)
+        return false;
+    const nl::json record(snapshot->find(uri));
+    if (record.is_null())
+        return false;
+    XTypePtr instance(XType::build_from(record, shared_from_this()));
+    // NOTE: If another thread has been faster, we keep its instance
+    return instance && commit(instance, false);
+}
+
+XTypeCPtr XTypeRegistry::get_committed(const std::string& uri)
 {
     XTypePtr result;
+    const std::size_t hash(std::hash<std::string>{}(uri));
+    Shard& shard(shard_of(hash));
+    UriHandle handle;
+    {
+        std::shared_lock< std::shared_mutex > lock(shard.mutex);
+        handle = shard.uris.find(uri, hash);
+        if (handle == UriTable::npos)
+        {
+            // We do not know ANY temporary or valid instance which has that uri
+            return nullptr;
+        }
+        // Check if that uri is known to point to a temporary instance
+        result = shard.valid_to_temporary[handle].lock();
+    }
 
-    // Check if that uri is known to point to a temporary instance
-    if (_valid_to_temporary.count(uri) && !_valid_to_temporary.at(uri).expired())
+    if (result)
     {
         // A valid copy exists. However it could be that it has been changed/altered by the user
-        result = _valid_to_temporary.at(uri).lock();
         const std::string current_uri(result->uri());
         // If the uris do not match
         if (uri != current_uri)
         {
             // ... we have to create a new temporary entry, so others can find that thing by old as well as new URI
-            _valid_to_temporary[current_uri] = result;
+            const std::size_t current_hash(std::hash<std::string>{}(current_uri));
+            Shard& current_shard(shard_of(current_hash));
+            std::unique_lock< std::shared_mutex > lock(current_shard.mutex);
+            current_shard.valid_to_temporary[current_shard.insert(current_uri, current_hash)] = result;
         }
         return result;
     }
 
     // When we come out here, we do NOT have a temporary copy yet
-    if (!knows_uri(uri))
+    std::unique_lock< std::shared_mutex > lock(shard.mutex);
+    // NOTE: Another thread might have dropped the uri (and reused its handle) or created the temporary copy in the meantime
+    handle = shard.uris.find(uri, hash);
+    if (handle == UriTable::npos)
+    {
+        return nullptr;
+    }
+    result = shard.valid_to_temporary[handle].lock();
+    if (result)
+    {
+        return result;
+    }
+    const XTypePtr& valid(shard.valid_instance(handle));
+    if (!valid)
     {
         // We do not know ANY temporary or valid instance which has that uri
         return nullptr;
     }
     // We know that uri, so we create a new temporary copy of it
-    XTypePtr valid(_valid_instances.at(uri));
     result = instantiate_from(valid->get_classname());
+    XTYPES_COUNT(CHECKOUT_COPIES);
     *result = *valid;
-    _valid_to_temporary[uri] = result;
+    shard.valid_to_temporary[handle] = result;
     return result;
 }
 
 XTypeCPtr XTypeRegistry::load_by_uri(const std::string& uri)
 {
+    XTYPES_TRACE("XTypeRegistry::load_by_uri", uri);
     XTypePtr instance(get_by_uri(uri));
     if (instance)
     {
+        XTYPES_COUNT(LOAD_HITS);
         return instance;
     }
     // Does not yet exist, so we ask the load func
-    instance = _load_func(uri);
+    XTYPES_COUNT(LOAD_MISSES);
+    LoadByUriFunc load_func;
+    LoadManyByUriFunc load_many_func;
+    {
+        std::shared_lock< std::shared_mutex > lock(_factories_mutex);
+        load_func = _load_func;
+        load_many_func = _load_many_func;
+    }
+    {
+        XTYPES_TIME(LOAD_FUNC);
+        XTYPES_TRACE("XTypeRegistry::load_func", uri);
+        if (!load_func && load_many_func)
+        {
+            for (const XTypePtr& loaded : load_many_func({uri}))
+            {
+                if (loaded && loaded->uri() == uri)
+                    instance = loaded;
+            }
+        }
+        else
+        {
+            instance = load_func(uri);
+        }
+    }
     if (!instance)
     {
+        XTYPES_COUNT(LOAD_FAILURES);
         return nullptr;
     }
     if (uri != instance->uri())
@@ -161,25 +584,333 @@ XTypeCPtr XTypeRegistry::load_by_uri(const std::string& uri)
 
 void XTypeRegistry::set_load_func(const LoadByUriFunc& f)
 {
+    std::unique_lock< std::shared_mutex > lock(_factories_mutex);
     _load_func = f;
 }
 
+std::vector< XTypePtr > XTypeRegistry::load_many(const std::vector< std::string >& uris)
+{
+    XTYPES_TRACE("XTypeRegistry::load_many", "");
+    std::vector< XTypePtr > result(uris.size());
+    // Resolve everything we already know and collect the rest (every uri only once)
+    std::map< std::string, std::vector< std::size_t > > missing;
+    for (std::size_t i = 0; i < uris.size(); ++i)
+    {
+        result[i] = get_by_uri(uris[i]);
+        if (!result[i])
+            missing[uris[i]].push_back(i);
+        else
+            XTYPES_COUNT(LOAD_HITS);
+    }
+    if (missing.empty())
+    {
+        return result;
+    }
+
+    LoadManyByUriFunc load_many_func;
+    {
+        std::shared_lock< std::shared_mutex > lock(_factories_mutex);
+        load_many_func = _load_many_func;
+    }
+    if (!load_many_func)
+    {
+        // Fall back to one call per uri
+        for (const auto &[uri, indices] : missing)
+        {
+            XTypePtr instance(load_by_uri(uri));
+            for (const std::size_t i : indices)
+                result[i] = instance;
+        }
+        return result;
+    }
+
+    // Ask the information source for all missing uris in one go
+    std::vector< std::string > missing_uris;
+    missing_uris.reserve(missing.size());
+    for (const auto &[uri, indices] : missing)
+        missing_uris.push_back(uri);
+    XTYPES_COUNT_N(LOAD_MISSES, missing_uris.size());
+    std::vector< XTypePtr > loaded;
+    {
+        XTYPES_TIME(LOAD_FUNC);
+        XTYPES_TRACE("XTypeRegistry::load_many_func", "");
+        loaded = load_many_func(missing_uris);
+    }
+    loaded.erase(std::remove(loaded.begin(), loaded.end(), nullptr), loaded.end());
+    XTYPES_COUNT_N(LOAD_FAILURES, missing_uris.size() - std::min(loaded.size(), missing_uris.size()));
+    for (const XTypePtr& instance : loaded)
+    {
+        const std::string uri(instance->uri());
+        if (!missing.count(uri))
+        {
+            throw std::runtime_error("XTypeRegistry::load_many(): URI mismatch! Got unrequested " + uri);
+        }
+    }
+    // Make sure that the instances are committed (the _load_many_func could already have done it though)
+    commit_many(loaded, true);
+    for (const auto &[uri, indices] : missing)
+    {
+        // We use get_by_uri() to now give us a temporary copy of the valid one
+        XTypePtr instance(get_by_uri(uri));
+        for (const std::size_t i : indices)
+            result[i] = instance;
+    }
+    return result;
+}
+
+void XTypeRegistry::set_load_many_func(const LoadManyByUriFunc& f)
+{
+    std::unique_lock< std::shared_mutex > lock(_factories_mutex);
+    _load_many_func = f;
+}
+
+std::future< XTypePtr > XTypeRegistry::load_by_uri_async(const std::string& uri)
+{
+    XTypeRegistryPtr self(shared_from_this());
+    // NOTE: std::function has to be copyable, so the task is shared
+    auto task = std::make_shared< std::packaged_task< XTypePtr() > >([self, uri]() { return self->load_by_uri(uri); });
+    std::future< XTypePtr > result(task->get_future());
+    // NOTE: The job keeps the registry alive, so the queue cannot have been stopped
+    TaskQueue::submit(_load_queue, [task]() { (*task)(); });
+    return result;
+}
+
+std::future< std::vector< XTypePtr > > XTypeRegistry::load_many_async(const std::vector< std::string >& uris)
+{
+    XTypeRegistryPtr self(shared_from_this());
+    bool batch;
+    {
+        std::shared_lock< std::shared_mutex > lock(_factories_mutex);
+        batch = static_cast< bool >(_load_many_func);
+    }
+    if (batch)
+    {
+        return std::async(std::launch::async, [self, uris]() { return self->load_many(uris); });
+    }
+    // Without a batch function we issue one load per unknown uri, so that the round trips overlap (at most max_load_threads at a time)
+    std::map< std::string, std::shared_future< XTypePtr > > loads;
+    for (const auto& uri : uris)
+    {
+        if (!loads.count(uri) && !knows_uri(uri))
+            loads[uri] = load_by_uri_async(uri).share();
+    }
+    return std::async(std::launch::async, [self, uris, loads]() {
+        std::vector< XTypePtr > result;
+        result.reserve(uris.size());
+        for (const auto& uri : uris)
+        {
+            const auto it = loads.find(uri);
+            result.push_back((it != loads.end()) ? it->second.get() : self->get_by_uri(uri));
+        }
+        return result;
+    });
+}
+
+void XTypeRegistry::set_prefetch_depth(const std::size_t depth)
+{
+    std::lock_guard< std::mutex > lock(_prefetch_mutex);
+    _prefetch_depth = depth;
+}
+
+std::size_t XTypeRegistry::get_prefetch_depth() const
+{
+    std::lock_guard< std::mutex > lock(_prefetch_mutex);
+    return _prefetch_depth;
+}
+
+std::vector< std::string > XTypeRegistry::unresolved_uris_of(const std::string& uri) const
+{
+    const std::size_t hash(std::hash<std::string>{}(uri));
+    const Shard& shard(shard_of(hash));
+    // NOTE: Valid instances are only altered under an exclusive lock, so we can read their facts here
+    std::shared_lock< std::shared_mutex > lock(shard.mutex);
+    const XTypePtr& valid(shard.valid_instance(shard.uris.find(uri, hash)));
+    if (!valid)
+        return {};
+    return valid->get_unresolved_uris();
+}
+
+void XTypeRegistry::prefetch(const std::vector< std::string >& uris, const std::size_t depth)
+{
+    const std::weak_ptr< XTypeRegistry > weak_self(weak_from_this());
+    if (uris.empty() || (depth == 0) || weak_self.expired())
+        return;
+    // NOTE: The job must not keep the registry alive while it is queued, so it only holds a weak reference.
+    // While it runs, it keeps the registry alive for one hop at a time. If it has released the last reference, the registry is destroyed in this thread
+    auto job = [weak_self, uris, depth]() {
+        std::set< std::string > visited(uris.begin(), uris.end());
+        std::vector< std::string > frontier(uris);
+        try {
+            for (std::size_t hop = 0; (hop < depth) && !frontier.empty(); ++hop)
+            {
+                XTypeRegistryPtr self(weak_self.lock());
+                if (!self)
+                    return;
+                // Collect the targets of the current frontier which we have not seen yet
+                std::vector< std::string > next;
+                for (const auto& uri : frontier)
+                {
+                    for (const auto& target : self->unresolved_uris_of(uri))
+                    {
+                        if (visited.insert(target).second)
+                            next.push_back(target);
+                    }
+                }
+                // Resolve them in one go
+                self->load_many(next);
+                frontier.swap(next);
+            }
+        } catch (...) {
+            // Prefetching is speculative. The error will show up again when the facts are actually resolved
+        }
+    };
+    TaskQueue::submit(_prefetch_queue, std::move(job), max_queued_prefetches);
+}
+
+void XTypeRegistry::wait_for_prefetches()
+{
+    TaskQueue& queue(*_prefetch_queue);
+    std::unique_lock< std::mutex > lock(queue.mutex);
+    queue.idle.wait(lock, [&queue]() { return queue.stopping || ((queue.n_running == 0) && queue.jobs.empty()); });
+}
+
+std::vector< std::uint8_t > XTypeRegistry::export_binary() const
+{
+    BinaryGraphWriter writer;
+    for (const auto& shard : _shards)
+    {
+        // NOTE: uri() updates the uri cache of the valid instances, so we need an exclusive lock here
+        std::unique_lock< std::shared_mutex > lock(shard->mutex);
+        for (const XTypePtr& valid : shard->valid_instances)
+        {
+            if (valid)
+                writer.add(valid->export_record());
+        }
+    }
+    return writer.finish();
+}
+
+std::size_t XTypeRegistry::import_binary(const std::vector< std::uint8_t >& data)
+{
+    return XType::commit_records(BinaryGraphReader(data), shared_from_this());
+}
+
+std::size_t XTypeRegistry::write_snapshot(const std::string& path) const
+{
+    RegistrySnapshot::Writer writer(path);
+    std::size_t n_written = 0;
+    for (const auto& shard : _shards)
+    {
+        // NOTE: uri() updates the uri cache of the valid instances, so we need an exclusive lock here
+        std::unique_lock< std::shared_mutex > lock(shard->mutex);
+        for (const XTypePtr& valid : shard->valid_instances)
+        {
+            if (!valid)
+                continue;
+            writer.add(valid->export_record());
+            n_written++;
+        }
+    }
+    writer.finish();
+    return n_written;
+}
+
+void XTypeRegistry::open_snapshot(const std::string& path)
+{
+    auto snapshot = std::make_shared< const RegistrySnapshot >(path);
+    std::unique_lock< std::shared_mutex > lock(_factories_mutex);
+    _snapshot = snapshot;
+}
+
+void XTypeRegistry::close_snapshot()
+{
+    std::unique_lock< std::shared_mutex > lock(_factories_mutex);
+    _snapshot.reset();
+}
+
 // TODO: drop() should just erase an XType from _valid_instances and _valid_copies to trigger a reload
 void XTypeRegistry::drop(const std::string& uri)
 {
-    _valid_instances.erase(uri);
-    _valid_to_temporary.erase(uri);
+    const std::size_t hash(std::hash<std::string>{}(uri));
+    Shard& shard(shard_of(hash));
+    std::unique_lock< std::shared_mutex > lock(shard.mutex);
+    const UriHandle handle(shard.uris.find(uri, hash));
+    if (handle >= shard.valid_instances.size())
+        return;
+    shard.valid_instances[handle].reset();
+    shard.valid_to_temporary[handle].reset();
+    // Release the uri, so its handle (and the entries above) can be reused
+    shard.uris.erase(uri, hash);
 }
 
 // TODO: We need a delete(uri) function to drop() and also remove any invalidated other instances
 // TODO: When we drop a valid instance others might also become invalid.
 // In that case we also have to destroy them or put them (back) to temporary instances and return them
 
+std::size_t XTypeRegistry::export_changes(const ChangeWriter& writer)
+{
+    std::vector< XTypeWeakPtr > changed;
+    {
+        std::lock_guard< std::mutex > lock(_changes_mutex);
+        changed.swap(_changed);
+        _next_changed_compaction = 1024;
+    }
+    std::unordered_set< const XType* > visited;
+    std::size_t n_written = 0;
+    for (const XTypeWeakPtr& entry : changed)
+    {
+        const XTypePtr instance(entry.lock());
+        if (!instance || !visited.insert(instance.get()).second)
+            continue;
+        // NOTE: Instances without a valid uri cannot be committed. They stay listed until they become valid
+        if (instance->has_changes() && !instance->is_uri_valid())
+        {
+            std::lock_guard< std::mutex > lock(_changes_mutex);
+            _changed.push_back(instance);
+            continue;
+        }
+        if (instance->has_changes())
+        {
+            commit(instance, true);
+            writer(instance->uri(), instance->export_changes_record());
+            n_written++;
+        }
+        instance->clear_changes();
+    }
+    return n_written;
+}
+
+void XTypeRegistry::track_change(const XTypeWeakPtr& instance)
+{
+    std::lock_guard< std::mutex > lock(_changes_mutex);
+    _changed.push_back(instance);
+    if (_changed.size() >= _next_changed_compaction)
+    {
+        _changed.erase(std::remove_if(_changed.begin(), _changed.end(),
+                                      [](const XTypeWeakPtr& entry) { return entry.expired(); }),
+                       _changed.end());
+        _next_changed_compaction = std::max< std::size_t >(1024, 2 * _changed.size());
+    }
+}
+
 void XTypeRegistry::clear()
 {
-    _temporary_instances.clear();
-    _valid_to_temporary.clear();
-    _valid_instances.clear();
+    {
+        std::lock_guard< std::mutex > lock(_temporary_instances_mutex);
+        _temporary_instances.clear();
+        _weak_temporary_instances.clear();
+    }
+    {
+        std::lock_guard< std::mutex > lock(_changes_mutex);
+        _changed.clear();
+    }
+    for (const auto& shard : _shards)
+    {
+        std::unique_lock< std::shared_mutex > lock(shard->mutex);
+        shard->valid_to_temporary.clear();
+        shard->valid_instances.clear();
+        shard->uris.clear();
+    }
 }
 
 }
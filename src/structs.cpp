@@ -1,11 +1,225 @@
 #include "structs.hpp"
 #include "XType.hpp"
+#include "utils.hpp"
+#include "UriTable.hpp"
+#include <shared_mutex>
+#include <string_view>
 
 
 using namespace xtypes;
 
-Fact::Fact(std::weak_ptr<XType> target, const nl::json& edge_properties)
-: target{target}, edge_properties(edge_properties)
+namespace {
+    // Strips a leading '/' so that "/a/b" and "a/b" address the same property
+    std::string_view normalized_key(const std::string& path_to_key)
+    {
+        std::string_view key(path_to_key);
+        if (!key.empty() && key.front() == '/')
+            key.remove_prefix(1);
+        return key;
+    }
+
+    // Returns true if the one key is a parent path of the other one
+    bool is_nested_in(const std::string& a, const std::string& b)
+    {
+        return (a.size() > b.size()) && (a.compare(0, b.size(), b) == 0) && (a[b.size()] == '/');
+    }
+}
+
+namespace {
+    /// All names interned by intern_name()
+    struct NameTable
+    {
+        std::shared_mutex mutex;
+        UriTable names;
+    };
+
+    NameTable& name_table()
+    {
+        static NameTable table;
+        return table;
+    }
+}
+
+NameId xtypes::intern_name(const std::string& name)
+{
+    NameTable& table(name_table());
+    const std::size_t hash(std::hash<std::string>{}(name));
+    {
+        std::shared_lock< std::shared_mutex > lock(table.mutex);
+        const NameId id(table.names.find(name, hash));
+        if (id != UriTable::npos)
+            return id;
+    }
+    std::unique_lock< std::shared_mutex > lock(table.mutex);
+    return table.names.intern(name, hash);
+}
+
+const std::string& xtypes::name_of(const NameId id)
+{
+    NameTable& table(name_table());
+    std::shared_lock< std::shared_mutex > lock(table.mutex);
+    return table.names.at(id);
+}
+
+ClassnameSet::ClassnameSet(std::set<std::string> names)
+: m_names(std::move(names))
+{
+    this->intern();
+}
+
+ClassnameSet::ClassnameSet(std::initializer_list<std::string> names)
+: m_names(names)
+{
+    this->intern();
+}
+
+bool ClassnameSet::insert(const std::string& name)
+{
+    if (!m_names.insert(name).second)
+        return false;
+    const NameId id(intern_name(name));
+    m_ids.insert(std::upper_bound(m_ids.begin(), m_ids.end(), id), id);
+    return true;
+}
+
+std::size_t ClassnameSet::erase(const std::string& name)
+{
+    if (m_names.erase(name) == 0)
+        return 0;
+    const NameId id(intern_name(name));
+    m_ids.erase(std::lower_bound(m_ids.begin(), m_ids.end(), id));
+    return 1;
+}
+
+void ClassnameSet::clear()
+{
+    m_names.clear();
+    m_ids.clear();
+}
+
+void ClassnameSet::intern()
+{
+    m_ids.clear();
+    m_ids.reserve(m_names.size());
+    for (const std::string& name : m_names)
+        m_ids.push_back(intern_name(name));
+    std::sort(m_ids.begin(), m_ids.end());
+}
+
+PropertyKey::PropertyKey(const std::string& path_to_key)
+: key(normalized_key(path_to_key)), pointer(PropertySchema::to_pointer(path_to_key)), hash(std::hash<std::string_view>{}(key))
+{}
+
+std::size_t PropertySchema::find_slot(const PropertyKey& key) const
+{
+    if (this->slot_buckets.empty())
+        return npos;
+    const std::size_t mask = this->slot_buckets.size() - 1;
+    for (std::size_t i = key.hash & mask; this->slot_buckets[i] > 0; i = (i + 1) & mask)
+    {
+        const PropertySlot& candidate(this->slots[this->slot_buckets[i] - 1]);
+        if ((candidate.hash == key.hash) && (candidate.key == key.key))
+            return this->slot_buckets[i] - 1;
+    }
+    return npos;
+}
+
+std::size_t PropertySchema::find_slot(const std::string& path_to_key) const
+{
+    if (this->slot_buckets.empty())
+        return npos;
+    const std::string_view key(normalized_key(path_to_key));
+    const std::size_t hash(std::hash<std::string_view>{}(key));
+    const std::size_t mask = this->slot_buckets.size() - 1;
+    for (std::size_t i = hash & mask; this->slot_buckets[i] > 0; i = (i + 1) & mask)
+    {
+        const PropertySlot& candidate(this->slots[this->slot_buckets[i] - 1]);
+        if ((candidate.hash == hash) && (candidate.key == key))
+            return this->slot_buckets[i] - 1;
+    }
+    return npos;
+}
+
+void PropertySchema::add_slot(const PropertyKey& key, const nl::json::value_t& type, const std::set<nl::json>& allowed_values)
+{
+    // Redefinition of an existing property
+    const std::size_t existing = this->find_slot(key);
+    if (existing != npos)
+    {
+        this->slots[existing].type = type;
+        this->slots[existing].allowed_values = allowed_values;
+        return;
+    }
+    // A new (leaf) property replaces any property nested in it and turns its parents into intermediate keys
+    const std::size_t n_slots = this->slots.size();
+    this->slots.erase(std::remove_if(this->slots.begin(), this->slots.end(), [&key](const PropertySlot& slot) {
+        return is_nested_in(slot.key, key.key) || is_nested_in(key.key, slot.key);
+    }), this->slots.end());
+    this->slots.push_back({key.key, key.pointer, key.hash, type, allowed_values});
+    // Keep the load factor of the hash table below 1/2
+    if ((this->slots.size() != n_slots + 1) || (2 * this->slots.size() > this->slot_buckets.size()))
+    {
+        this->rebuild_slot_buckets();
+        return;
+    }
+    const std::size_t mask = this->slot_buckets.size() - 1;
+    std::size_t i = key.hash & mask;
+    while (this->slot_buckets[i] > 0)
+        i = (i + 1) & mask;
+    this->slot_buckets[i] = this->slots.size();
+}
+
+void PropertySchema::rebuild_slot_buckets()
+{
+    std::size_t n_buckets = 8;
+    while (n_buckets < 2 * this->slots.size())
+        n_buckets *= 2;
+    this->slot_buckets.assign(n_buckets, 0);
+    const std::size_t mask = n_buckets - 1;
+    for (std::size_t s = 0; s < this->slots.size(); ++s)
+    {
+        std::size_t i = this->slots[s].hash & mask;
+        while (this->slot_buckets[i] > 0)
+            i = (i + 1) & mask;
+        this->slot_buckets[i] = s + 1;
+    }
+}
+
+void PropertySchema::compile()
+{
+    this->slots.clear();
+    const nl::json flattened(this->property_types.flatten());
+    for (const auto& [k, v] : flattened.items())
+    {
+        if (k.empty()) continue;
+        const PropertyKey key(k);
+        const std::set<nl::json> allowed(this->allowed_values.contains(key.pointer) ? this->allowed_values.at(key.pointer).get<std::set<nl::json>>() : std::set<nl::json>{});
+        this->slots.push_back({key.key, key.pointer, key.hash, v.get<nl::json::value_t>(), allowed});
+    }
+    this->rebuild_slot_buckets();
+}
+
+nl::json PropertySchema::validated_values(const nl::json& values) const
+{
+    if (this->slots.empty())
+        return nullptr;
+    // Start with the defaults and take over the valid values
+    nl::json result(this->default_values);
+    if (!values.is_object() || values.empty())
+        return result;
+    for (const PropertySlot& slot : this->slots)
+    {
+        if (!values.contains(slot.pointer))
+            continue;
+        const nl::json& value(values.at(slot.pointer));
+        if (is_type_matching(slot.type, value) && is_allowed_value(slot.allowed_values, value))
+            result[slot.pointer] = value;
+    }
+    return result;
+}
+
+Fact::Fact(std::weak_ptr<XType> target, nl::json edge_properties)
+: target{target}, edge_properties(std::move(edge_properties))
 {}
 
 bool Fact::operator!=(const Fact& other) const
@@ -29,12 +243,12 @@ bool Fact::operator==(const Fact& other) const
     return false;
 }
 
-ExtendedFact::ExtendedFact(const std::string& target_uri, const nl::json& edge_properties)
-: Fact({}, edge_properties), _target_uri{target_uri}
+ExtendedFact::ExtendedFact(const std::string& target_uri, nl::json edge_properties)
+: Fact({}, std::move(edge_properties)), _target_uri{target_uri}
 {}
 
-ExtendedFact::ExtendedFact(std::weak_ptr<XType> target, const nl::json& edge_properties)
-: Fact(target, edge_properties)
+ExtendedFact::ExtendedFact(std::weak_ptr<XType> target, nl::json edge_properties)
+: Fact(target, std::move(edge_properties))
 {
     _target_uri = target_uri();
 }
@@ -61,6 +275,12 @@ void ExtendedFact::target_uri(const std::string& uri)
     }
 }
 
+bool ExtendedFact::is_target_uri_current() const
+{
+    const std::shared_ptr<XType> t(target.lock());
+    return !t || (t->is_uri_valid() && (t->uri() == _target_uri));
+}
+
 bool ExtendedFact::operator!=(const ExtendedFact& other) const
 {
     return !(*(this) == other);
@@ -80,3 +300,209 @@ bool ExtendedFact::operator==(const ExtendedFact& other) const
     // Different edge_properties could produce two facts with the same URI in an e.g. std::set which would be wrong.
     return false;
 }
+
+FactList::FactList() : epoch(XType::uri_epoch())
+{}
+
+FactList::FactList(std::initializer_list< ExtendedFact > facts) : FactList()
+{
+    this->reserve(facts.size());
+    for (const ExtendedFact& fact : facts)
+        this->push_back(fact);
+}
+
+bool FactList::uuid_of(const ExtendedFact& fact, std::size_t& uuid)
+{
+    // NOTE: Same as uri_to_uuid(fact.target_uri()), but uses the uuid cached by the target
+    const std::shared_ptr<XType> target(fact.target.lock());
+    if (target && target->is_uri_valid())
+    {
+        uuid = target->uuid();
+        return true;
+    }
+    if (fact._target_uri.empty())
+        return false;
+    uuid = uri_to_uuid(fact._target_uri);
+    return true;
+}
+
+std::size_t FactList::find(const ExtendedFact& fact) const
+{
+    // Same target
+    const std::shared_ptr<XType> target(fact.target.lock());
+    if (target)
+    {
+        const auto range = this->by_target.equal_range(target.get());
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (this->entries[it->second] == fact)
+                return it->second;
+        }
+    }
+    // Same target uri
+    std::size_t uuid;
+    if (!uuid_of(fact, uuid))
+        return npos;
+    const auto range = this->by_uuid.equal_range(uuid);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (this->entries[it->second] == fact)
+            return it->second;
+    }
+    return npos;
+}
+
+void FactList::push_back(ExtendedFact fact)
+{
+    this->entries.push_back(std::move(fact));
+    this->keys.emplace_back();
+    this->removed.push_back(false);
+    this->index(this->entries.size() - 1);
+}
+
+void FactList::reserve(const std::size_t n)
+{
+    this->entries.reserve(n);
+    this->keys.reserve(n);
+    this->removed.reserve(n);
+    this->by_target.reserve(n);
+    this->by_uuid.reserve(n);
+}
+
+void FactList::index(const std::size_t slot)
+{
+    const ExtendedFact& fact(this->entries[slot]);
+    IndexKeys& key(this->keys[slot]);
+    const std::shared_ptr<XType> target(fact.target.lock());
+    key.target = target.get();
+    if (key.target)
+        this->by_target.emplace(key.target, slot);
+    key.has_uuid = uuid_of(fact, key.uuid);
+    if (key.has_uuid)
+        this->by_uuid.emplace(key.uuid, slot);
+    // The uri of such a target changes with the uris of its own targets, which we do not get to know
+    if (target && !target->get_uri_relations().empty())
+    {
+        key.derived_revision = target->uri_revision();
+        this->derived_slots.insert(slot);
+    }
+}
+
+void FactList::unindex(const std::size_t slot)
+{
+    const IndexKeys& key(this->keys.at(slot));
+    if (key.target)
+    {
+        const auto range = this->by_target.equal_range(key.target);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == slot)
+            {
+                this->by_target.erase(it);
+                break;
+            }
+        }
+    }
+    if (key.has_uuid)
+    {
+        const auto range = this->by_uuid.equal_range(key.uuid);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == slot)
+            {
+                this->by_uuid.erase(it);
+                break;
+            }
+        }
+    }
+    this->derived_slots.erase(slot);
+    this->keys[slot] = IndexKeys();
+}
+
+void FactList::erase(const std::size_t slot)
+{
+    if (this->removed.at(slot))
+        return;
+    this->unindex(slot);
+    this->removed[slot] = true;
+    this->n_removed++;
+}
+
+std::size_t FactList::remove(const ExtendedFact& fact)
+{
+    std::size_t n = 0;
+    for (std::size_t slot = this->find(fact); slot != npos; slot = this->find(fact))
+    {
+        this->erase(slot);
+        n++;
+    }
+    if (2 * this->n_removed > this->entries.size())
+        this->compact();
+    return n;
+}
+
+void FactList::compact()
+{
+    std::vector< ExtendedFact > remaining;
+    remaining.reserve(this->size());
+    for (std::size_t slot = 0; slot < this->entries.size(); ++slot)
+    {
+        if (!this->removed[slot])
+            remaining.push_back(std::move(this->entries[slot]));
+    }
+    this->entries.swap(remaining);
+    this->removed.assign(this->entries.size(), false);
+    this->n_removed = 0;
+    this->reindex();
+}
+
+bool FactList::is_index_current() const
+{
+    return this->epoch == XType::uri_epoch();
+}
+
+void FactList::refresh()
+{
+    std::vector< const XType* > changed;
+    // If we do not know all changed targets, we have to check every fact
+    if (!XType::uri_changes_since(this->epoch, changed) || (changed.size() >= this->entries.size()) ||
+        (std::find(changed.begin(), changed.end(), nullptr) != changed.end()))
+    {
+        this->reindex();
+        return;
+    }
+    std::vector< std::size_t > stale;
+    for (const XType* target : changed)
+    {
+        const auto range = this->by_target.equal_range(target);
+        for (auto it = range.first; it != range.second; ++it)
+            stale.push_back(it->second);
+    }
+    for (const std::size_t slot : this->derived_slots)
+    {
+        const std::shared_ptr<XType> target(this->entries[slot].target.lock());
+        if (!target || (target->uri_revision() != this->keys[slot].derived_revision))
+            stale.push_back(slot);
+    }
+    std::sort(stale.begin(), stale.end());
+    stale.erase(std::unique(stale.begin(), stale.end()), stale.end());
+    for (const std::size_t slot : stale)
+    {
+        this->unindex(slot);
+        this->index(slot);
+    }
+}
+
+void FactList::reindex()
+{
+    this->epoch = XType::uri_epoch();
+    this->by_target.clear();
+    this->by_uuid.clear();
+    this->derived_slots.clear();
+    this->keys.assign(this->entries.size(), IndexKeys());
+    for (std::size_t slot = 0; slot < this->entries.size(); ++slot)
+    {
+        if (!this->removed[slot])
+            this->index(slot);
+    }
+}
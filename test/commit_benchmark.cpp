@@ -0,0 +1,156 @@
+/*
+ * Counts the heap allocations of commit/get_by_uri cycles of the XTypeRegistry.
+ * Every cycle checks out a committed instance (get_by_uri() creates a fresh temporary copy), optionally modifies it and commits it again.
+ * The instance has a few dozen properties and many facts, so copying all of its data shows up clearly.
+ *
+ * Usage: XTypeRegistry_commit_bench [n_cycles] [n_facts] (default: 100000 100)
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "XType.hpp"
+#include "XTypeRegistry.hpp"
+
+// Count every allocation of the process
+static std::atomic< std::size_t > n_allocations{0};
+static std::atomic< std::size_t > n_allocated_bytes{0};
+
+void* operator new(std::size_t size)
+{
+    n_allocations++;
+    n_allocated_bytes += size;
+    if (void* p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+using namespace xtypes;
+
+namespace {
+    /// An XType with many properties and a relation to other nodes
+    class BenchNode : public XType
+    {
+    public:
+        static inline const std::string classname = "BenchNode";
+
+        BenchNode() : XType(BenchNode::classname)
+        {
+            if (adopt_class_schema(BenchNode::classname))
+                return;
+            define_property("name", nl::json::value_t::string, {}, "");
+            for (int i = 0; i < 32; ++i)
+                define_property("attribute" + std::to_string(i), nl::json::value_t::string, {}, "some rather long default value of an attribute");
+            define_relation("links", RelationType::CONNECTED_TO, {BenchNode::classname}, {BenchNode::classname});
+            share_class_schema(BenchNode::classname);
+        }
+
+    protected:
+        std::string build_uri() const override
+        {
+            return "bench:/root/path/to/a/rather/deep/module/" + get_property("name").get<std::string>();
+        }
+        const std::set<std::string>& get_uri_properties() const override
+        {
+            static const std::set<std::string> props{"name"};
+            return props;
+        }
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    /// Runs n cycles of f and prints the allocations and the time per cycle
+    template <typename F>
+    void measure(const std::string& label, const std::size_t n, F&& f)
+    {
+        const std::size_t allocations_before = n_allocations;
+        const std::size_t bytes_before = n_allocated_bytes;
+        const auto start = Clock::now();
+        for (std::size_t i = 0; i < n; ++i)
+            f(i);
+        const std::chrono::duration<double> elapsed = Clock::now() - start;
+        std::cout << std::setw(32) << label
+                  << std::setw(16) << std::fixed << std::setprecision(1) << static_cast< double >(n_allocations - allocations_before) / n
+                  << std::setw(16) << static_cast< double >(n_allocated_bytes - bytes_before) / n
+                  << std::setw(16) << std::setprecision(3) << 1e6 * elapsed.count() / n << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t n_cycles = (argc > 1) ? std::stoull(argv[1]) : 100000;
+    const std::size_t n_facts = (argc > 2) ? std::stoull(argv[2]) : 100;
+
+    auto registry = std::make_shared<XTypeRegistry>();
+    registry->register_class<BenchNode>();
+    registry->set_temporary_policy(TemporaryPolicy::KEEP_NONE);
+
+    // The node under test links to n_facts committed nodes
+    std::vector< XTypePtr > targets;
+    for (std::size_t i = 0; i < n_facts; ++i)
+    {
+        XTypePtr target = registry->instantiate_from(BenchNode::classname);
+        target->set_property("name", "target" + std::to_string(i));
+        target->set_all_unknown_facts_empty();
+        registry->commit(target, true);
+        targets.push_back(target);
+    }
+    std::string uri;
+    {
+        XTypePtr node = registry->instantiate_from(BenchNode::classname);
+        node->set_property("name", "node");
+        node->set_all_unknown_facts_empty();
+        for (const XTypePtr& target : targets)
+            node->add_fact("links", target);
+        registry->commit(node, true);
+        uri = node->uri();
+    }
+    XTypePtr extra = registry->instantiate_from(BenchNode::classname);
+    extra->set_property("name", "extra");
+    extra->set_all_unknown_facts_empty();
+    registry->commit(extra, true);
+
+    std::cout << "commit/get_by_uri cycles of an instance with 33 properties and " << n_facts << " facts" << std::endl;
+    std::cout << std::setw(32) << "cycle"
+              << std::setw(16) << "allocations"
+              << std::setw(16) << "bytes"
+              << std::setw(16) << "time [us]" << std::endl;
+    measure("get_by_uri", n_cycles, [&](std::size_t) {
+        registry->get_by_uri(uri);
+    });
+    measure("get_by_uri + get_facts", n_cycles, [&](std::size_t) {
+        registry->get_by_uri(uri)->get_facts("links");
+    });
+    measure("get_by_uri + commit", n_cycles, [&](std::size_t) {
+        registry->commit(registry->get_by_uri(uri), true);
+    });
+    measure("get_by_uri + set_property + commit", n_cycles, [&](std::size_t i) {
+        XTypePtr node(registry->get_by_uri(uri));
+        node->set_property("attribute0", std::to_string(i));
+        registry->commit(node, true);
+    });
+    measure("get_by_uri + add_fact + commit", n_cycles, [&](std::size_t i) {
+        XTypePtr node(registry->get_by_uri(uri));
+        if (i % 2)
+            node->remove_fact("links", extra);
+        else
+            node->add_fact("links", extra);
+        registry->commit(node, true);
+    });
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * Measures how the JSON lines export scales with the number of threads which serialize the XTypes (see XType::export_to_stream_parallel()).
+ * The nodes of a tree have a few dozen properties, so serializing and dumping them dominates the export.
+ * The traversal itself (resolving facts and committing) stays sequential, so it limits the speedup.
+ *
+ * Usage: XType_export_bench [n_nodes] [max_threads] (default: 200000 32)
+ */
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "XType.hpp"
+#include "XTypeRegistry.hpp"
+
+using namespace xtypes;
+
+namespace {
+    /// An XType with many properties and a relation to its children
+    class BenchNode : public XType
+    {
+    public:
+        static inline const std::string classname = "BenchNode";
+
+        BenchNode() : XType(BenchNode::classname)
+        {
+            if (adopt_class_schema(BenchNode::classname))
+                return;
+            define_property("name", nl::json::value_t::string, {}, "");
+            for (int i = 0; i < 32; ++i)
+                define_property("attribute" + std::to_string(i), nl::json::value_t::string, {}, "some rather long default value of an attribute");
+            define_property("position", nl::json::value_t::array, {}, nl::json::array({0.0, 0.0, 0.0}));
+            define_relation("children", RelationType::CONNECTED_TO, {BenchNode::classname}, {BenchNode::classname});
+            share_class_schema(BenchNode::classname);
+        }
+
+    protected:
+        std::string build_uri() const override
+        {
+            return "bench:/root/path/to/a/rather/deep/module/" + get_property("name").get<std::string>();
+        }
+        const std::set<std::string>& get_uri_properties() const override
+        {
+            static const std::set<std::string> props{"name"};
+            return props;
+        }
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    double seconds_since(const Clock::time_point& start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t n_nodes = (argc > 1) ? std::stoull(argv[1]) : 200000;
+    const std::size_t max_threads = (argc > 2) ? std::stoull(argv[2]) : 32;
+
+    // Build a tree: node i has the nodes 4i+1 ... 4i+4 as children
+    auto registry = std::make_shared<XTypeRegistry>();
+    registry->register_class<BenchNode>();
+    registry->set_temporary_policy(TemporaryPolicy::KEEP_NONE);
+    std::vector< XTypePtr > nodes;
+    nodes.reserve(n_nodes);
+    for (std::size_t i = 0; i < n_nodes; ++i)
+    {
+        XTypePtr node = registry->instantiate_from(BenchNode::classname);
+        node->set_property("name", "node" + std::to_string(i));
+        node->set_property("attribute0", "value of node " + std::to_string(i));
+        node->set_property("position", {0.5 * i, 1.5 * i, 2.5 * i});
+        node->set_all_unknown_facts_empty();
+        if (i > 0)
+            nodes[(i - 1) / 4]->add_fact("children", node);
+        nodes.push_back(node);
+    }
+
+    // The first export commits all nodes, so every run below does the same work
+    std::stringstream warmup;
+    nodes.front()->export_to_stream(warmup);
+    const std::size_t n_bytes = warmup.str().size();
+
+    auto start = Clock::now();
+    std::stringstream sequential;
+    nodes.front()->export_to_stream(sequential);
+    const double sequential_time = seconds_since(start);
+
+    std::cout << "JSON lines export of " << n_nodes << " nodes (" << n_bytes << " bytes, hardware threads: " << std::thread::hardware_concurrency() << ")" << std::endl;
+    std::cout << std::setw(12) << "threads"
+              << std::setw(14) << "time [s]"
+              << std::setw(14) << "nodes/s"
+              << std::setw(10) << "speedup" << std::endl;
+    std::cout << std::setw(12) << "sequential"
+              << std::setw(14) << std::fixed << std::setprecision(3) << sequential_time
+              << std::setw(14) << static_cast<std::size_t>(n_nodes / sequential_time)
+              << std::setw(10) << std::setprecision(2) << 1.0 << std::endl;
+    for (std::size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2)
+    {
+        start = Clock::now();
+        std::stringstream parallel;
+        nodes.front()->export_to_stream_parallel(parallel, n_threads);
+        const double parallel_time = seconds_since(start);
+        if (parallel.str() != sequential.str())
+            std::cerr << "The parallel export with " << n_threads << " threads differs from the sequential one" << std::endl;
+        std::cout << std::setw(12) << n_threads
+                  << std::setw(14) << std::setprecision(3) << parallel_time
+                  << std::setw(14) << static_cast<std::size_t>(n_nodes / parallel_time)
+                  << std::setw(10) << std::setprecision(2) << sequential_time / parallel_time << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+/*
+ * A minimal timer framework for the benchmarks of xtypes_bench.
+ * Every benchmark is repeated several times. Before each repetition an (untimed) setup builds a fresh fixture,
+ * so benchmarks which modify their fixture measure the same work every time.
+ * The results are printed as a table and can additionally be written as JSON lines (one object per benchmark).
+ */
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace xtypes_bench
+{
+    /// Parameters which describe a benchmark (e.g. the topology and size of the graph)
+    using Params = std::map< std::string, nlohmann::json >;
+
+    class Runner
+    {
+    public:
+        /// Parses the options --filter=<substring>, --repetitions=<n>, --scale=<factor> and --output=<file>
+        Runner(int argc, char** argv)
+        {
+            for (int i = 1; i < argc; ++i)
+            {
+                const std::string arg(argv[i]);
+                if (arg.rfind("--filter=", 0) == 0)
+                    this->filter = arg.substr(9);
+                else if (arg.rfind("--repetitions=", 0) == 0)
+                    this->repetitions = std::max< std::size_t >(std::stoull(arg.substr(14)), 1);
+                else if (arg.rfind("--scale=", 0) == 0)
+                    this->scale = std::stod(arg.substr(8));
+                else if (arg.rfind("--output=", 0) == 0)
+                    this->output.open(arg.substr(9), std::ios::trunc);
+                else
+                    throw std::invalid_argument("Usage: " + std::string(argv[0]) + " [--filter=<substring>] [--repetitions=<n>] [--scale=<factor>] [--output=<file>]");
+            }
+            if (this->output.is_open())
+            {
+                this->output << nlohmann::json{{"context", {
+                    {"compiler", __VERSION__},
+#ifdef NDEBUG
+                    {"assertions", false},
+#else
+                    {"assertions", true},
+#endif
+                    {"hardware_threads", std::thread::hardware_concurrency()},
+                    {"repetitions", this->repetitions},
+                    {"scale", this->scale}}}}.dump() << '\n';
+            }
+            std::cout << std::left << std::setw(40) << "benchmark" << std::setw(32) << "params" << std::right
+                      << std::setw(12) << "ops" << std::setw(14) << "median [ns]" << std::setw(14) << "min [ns]" << std::endl;
+        }
+
+        /// Returns a size multiplied by the scale factor (at least 1)
+        std::size_t scaled(const std::size_t size) const
+        {
+            return std::max< std::size_t >(static_cast< std::size_t >(size * this->scale), 1);
+        }
+
+        /// Returns true if a benchmark is selected by the filter
+        bool selected(const std::string& name) const
+        {
+            return name.find(this->filter) != std::string::npos;
+        }
+
+        /**
+         * Runs a benchmark and reports the time per operation
+         * @param setup Builds the fixture (not timed)
+         * @param body The timed part. Returns the number of operations it has done
+         */
+        void run(const std::string& name, const Params& params, const std::function< void() >& setup, const std::function< std::size_t() >& body)
+        {
+            if (!this->selected(name))
+                return;
+            std::vector< double > ns_per_op;
+            std::size_t n_ops = 0;
+            for (std::size_t i = 0; i < this->repetitions; ++i)
+            {
+                if (setup)
+                    setup();
+                const auto start = std::chrono::steady_clock::now();
+                n_ops = std::max< std::size_t >(body(), 1);
+                const std::chrono::duration< double, std::nano > elapsed = std::chrono::steady_clock::now() - start;
+                ns_per_op.push_back(elapsed.count() / n_ops);
+            }
+            std::sort(ns_per_op.begin(), ns_per_op.end());
+            const double median = ns_per_op[ns_per_op.size() / 2];
+            std::cout << std::left << std::setw(40) << name << std::setw(32) << nlohmann::json(params).dump() << std::right
+                      << std::setw(12) << n_ops
+                      << std::setw(14) << std::fixed << std::setprecision(1) << median
+                      << std::setw(14) << ns_per_op.front() << std::endl;
+            if (this->output.is_open())
+            {
+                this->output << nlohmann::json{{"benchmark", name},
+                                               {"params", params},
+                                               {"ops", n_ops},
+                                               {"ns_per_op_median", median},
+                                               {"ns_per_op_min", ns_per_op.front()},
+                                               {"ns_per_op_max", ns_per_op.back()}}.dump() << '\n';
+            }
+        }
+
+        /// Reports measured values which are not times (e.g. collision counts)
+        void report(const std::string& name, const Params& params, const nlohmann::json& values)
+        {
+            if (!this->selected(name))
+                return;
+            std::cout << std::left << std::setw(40) << name << std::setw(32) << nlohmann::json(params).dump() << values.dump() << std::endl;
+            if (this->output.is_open())
+                this->output << nlohmann::json{{"benchmark", name}, {"params", params}, {"values", values}}.dump() << '\n';
+        }
+
+    private:
+        std::string filter;
+        std::size_t repetitions = 5;
+        double scale = 1.0;
+        std::ofstream output;
+    };
+}
@@ -0,0 +1,124 @@
+/*
+ * Measures the uri lookup throughput of the XTypeRegistry for different numbers of committed instances.
+ * As a reference the same lookups are done on a std::map keyed by uri strings (the former storage of the registry).
+ *
+ * Usage: XTypeRegistry_bench [n_instances ...] (default: 10000 1000000 10000000)
+ * NOTE: 10M committed instances need several GB of memory
+ */
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "XType.hpp"
+#include "XTypeRegistry.hpp"
+
+using namespace xtypes;
+
+namespace {
+    /// An XType whose uri shares a long prefix with all others (like most generated ones)
+    class BenchNode : public XType
+    {
+    public:
+        static inline const std::string classname = "BenchNode";
+
+        BenchNode() : XType(BenchNode::classname)
+        {
+            if (adopt_class_schema(BenchNode::classname))
+                return;
+            define_property("name", nl::json::value_t::string, {}, "");
+            share_class_schema(BenchNode::classname);
+        }
+
+    protected:
+        std::string build_uri() const override
+        {
+            return "bench:/root/path/to/a/rather/deep/module/" + get_property("name").get<std::string>();
+        }
+        const std::set<std::string>& get_uri_properties() const override
+        {
+            static const std::set<std::string> props{"name"};
+            return props;
+        }
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    /// Runs f n times and returns the number of calls per second
+    template <typename F>
+    double throughput(const std::size_t n, F&& f)
+    {
+        const auto start = Clock::now();
+        for (std::size_t i = 0; i < n; ++i)
+            f(i);
+        const std::chrono::duration<double> elapsed = Clock::now() - start;
+        return n / elapsed.count();
+    }
+
+    void run(const std::size_t n_instances)
+    {
+        const std::size_t n_lookups = std::min< std::size_t >(n_instances, 1000000);
+        auto registry = std::make_shared<XTypeRegistry>();
+        registry->register_class<BenchNode>();
+        std::map< std::string, XTypePtr > reference;
+
+        std::vector< std::string > uris;
+        uris.reserve(n_instances);
+        const double commits = throughput(n_instances, [&](const std::size_t i) {
+            XTypePtr node = std::make_shared<BenchNode>();
+            node->set_property("name", "node" + std::to_string(i));
+            registry->commit(node, true);
+            uris.push_back(node->uri());
+        });
+        for (const auto& uri : uris)
+            reference[uri] = nullptr;
+
+        // Random access pattern over all committed uris
+        std::mt19937 rng(42);
+        std::uniform_int_distribution< std::size_t > pick(0, n_instances - 1);
+        std::vector< const std::string* > hits(n_lookups);
+        for (auto& hit : hits)
+            hit = &uris[pick(rng)];
+        std::vector< std::string > misses(n_lookups);
+        for (std::size_t i = 0; i < n_lookups; ++i)
+            misses[i] = "bench:/root/path/to/a/rather/deep/module/missing" + std::to_string(i);
+
+        std::size_t found = 0;
+        const double registry_hits = throughput(n_lookups, [&](const std::size_t i) { found += registry->knows_uri(*hits[i]); });
+        const double registry_misses = throughput(n_lookups, [&](const std::size_t i) { found += registry->knows_uri(misses[i]); });
+        const double map_hits = throughput(n_lookups, [&](const std::size_t i) { found += reference.count(*hits[i]); });
+        const double map_misses = throughput(n_lookups, [&](const std::size_t i) { found += reference.count(misses[i]); });
+        if (found != 2 * n_lookups)
+            std::cerr << "Unexpected number of hits: " << found << std::endl;
+
+        std::cout << std::setw(10) << n_instances
+                  << std::setw(14) << static_cast<std::size_t>(commits)
+                  << std::setw(14) << static_cast<std::size_t>(registry_hits)
+                  << std::setw(14) << static_cast<std::size_t>(registry_misses)
+                  << std::setw(14) << static_cast<std::size_t>(map_hits)
+                  << std::setw(14) << static_cast<std::size_t>(map_misses) << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector< std::size_t > sizes;
+    for (int i = 1; i < argc; ++i)
+        sizes.push_back(std::stoull(argv[i]));
+    if (sizes.empty())
+        sizes = {10000, 1000000, 10000000};
+
+    std::cout << "Throughput in operations per second" << std::endl;
+    std::cout << std::setw(10) << "instances"
+              << std::setw(14) << "commit"
+              << std::setw(14) << "hit"
+              << std::setw(14) << "miss"
+              << std::setw(14) << "map hit"
+              << std::setw(14) << "map miss" << std::endl;
+    for (const std::size_t n : sizes)
+        run(n);
+    return 0;
+}
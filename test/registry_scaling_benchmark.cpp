@@ -0,0 +1,120 @@
+/*
+ * Measures how the XTypeRegistry scales with the number of threads which resolve uris and commit disjoint instances.
+ * Every thread does 9 uri lookups per commit. The run is repeated with a single shard and with 64 shards.
+ *
+ * Usage: XTypeRegistry_scaling_bench [max_threads] (default: 64)
+ */
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "XType.hpp"
+#include "XTypeRegistry.hpp"
+
+using namespace xtypes;
+
+namespace {
+    /// An XType whose uri is built from its name
+    class BenchNode : public XType
+    {
+    public:
+        static inline const std::string classname = "BenchNode";
+
+        BenchNode() : XType(BenchNode::classname)
+        {
+            if (adopt_class_schema(BenchNode::classname))
+                return;
+            define_property("name", nl::json::value_t::string, {}, "");
+            share_class_schema(BenchNode::classname);
+        }
+
+    protected:
+        std::string build_uri() const override
+        {
+            return "bench:/root/" + get_property("name").get<std::string>();
+        }
+        const std::set<std::string>& get_uri_properties() const override
+        {
+            static const std::set<std::string> props{"name"};
+            return props;
+        }
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    const std::size_t n_preloaded = 100000;
+    const std::size_t n_operations_per_thread = 200000;
+
+    /// Returns the number of operations per second of all threads together
+    double run(const std::size_t n_threads, const std::size_t n_shards)
+    {
+        auto registry = std::make_shared<XTypeRegistry>(n_shards);
+        registry->register_class<BenchNode>();
+        std::vector< std::string > uris;
+        for (std::size_t i = 0; i < n_preloaded; ++i)
+        {
+            XTypePtr node = std::make_shared<BenchNode>();
+            node->set_property("name", "preloaded" + std::to_string(i));
+            registry->commit(node, true);
+            uris.push_back(node->uri());
+        }
+
+        std::vector< std::thread > threads;
+        const auto start = Clock::now();
+        for (std::size_t t = 0; t < n_threads; ++t)
+        {
+            threads.emplace_back([&, t]() {
+                std::mt19937 rng(t);
+                std::uniform_int_distribution< std::size_t > pick(0, uris.size() - 1);
+                XTypePtr node = std::make_shared<BenchNode>();
+                std::size_t found = 0;
+                for (std::size_t i = 0; i < n_operations_per_thread; ++i)
+                {
+                    if (i % 10 == 0)
+                    {
+                        node->set_property("name", "thread" + std::to_string(t) + "_" + std::to_string(i));
+                        registry->commit(node, true);
+                    }
+                    else
+                    {
+                        found += registry->knows_uri(uris[pick(rng)]);
+                    }
+                }
+                if (found == 0)
+                    std::cerr << "No uri found" << std::endl;
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        const std::chrono::duration<double> elapsed = Clock::now() - start;
+        return n_threads * n_operations_per_thread / elapsed.count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t max_threads = (argc > 1) ? std::stoull(argv[1]) : 64;
+
+    std::cout << "Throughput in operations per second (hardware threads: " << std::thread::hardware_concurrency() << ")" << std::endl;
+    std::cout << std::setw(8) << "threads"
+              << std::setw(14) << "1 shard"
+              << std::setw(14) << "64 shards"
+              << std::setw(10) << "speedup" << std::endl;
+    double single = 0.0;
+    for (std::size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2)
+    {
+        const double one_shard = run(n_threads, 1);
+        const double many_shards = run(n_threads, 64);
+        if (n_threads == 1)
+            single = many_shards;
+        std::cout << std::setw(8) << n_threads
+                  << std::setw(14) << static_cast<std::size_t>(one_shard)
+                  << std::setw(14) << static_cast<std::size_t>(many_shards)
+                  << std::setw(10) << std::fixed << std::setprecision(2) << many_shards / single << std::endl;
+    }
+    return 0;
+}
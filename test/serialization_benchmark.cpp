@@ -0,0 +1,176 @@
+/*
+ * Compares the JSON lines serialization (export_to_stream()/import_from_stream()) with the binary one (export_binary()/import_binary())
+ * on a binary tree of nodes. Both export the whole tree starting at its root.
+ * The parse column shows the decoding of the records alone (without instantiating and committing XTypes).
+ * The JSON lines are imported once more with n_threads threads parsing and instantiating the records.
+ * Finally the imported registry is written to a snapshot, which is opened and looked up by a fresh registry.
+ *
+ * Usage: XType_serialization_bench [n_nodes] [n_threads] (default: 1000000, one per hardware thread)
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BinaryFormat.hpp"
+#include "XType.hpp"
+#include "XTypeRegistry.hpp"
+
+using namespace xtypes;
+
+namespace {
+    /// An XType with a few properties and a relation to its children
+    class BenchNode : public XType
+    {
+    public:
+        static inline const std::string classname = "BenchNode";
+
+        BenchNode() : XType(BenchNode::classname)
+        {
+            if (adopt_class_schema(BenchNode::classname))
+                return;
+            define_property("name", nl::json::value_t::string, {}, "");
+            define_property("weight", nl::json::value_t::number_float, {}, 0.0);
+            define_property("tags", nl::json::value_t::array, {}, nl::json::array());
+            define_relation("children", RelationType::CONNECTED_TO, {BenchNode::classname}, {BenchNode::classname});
+            share_class_schema(BenchNode::classname);
+        }
+
+    protected:
+        std::string build_uri() const override
+        {
+            return "bench:/root/path/to/a/rather/deep/module/" + get_property("name").get<std::string>();
+        }
+        const std::set<std::string>& get_uri_properties() const override
+        {
+            static const std::set<std::string> props{"name"};
+            return props;
+        }
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    double seconds_since(const Clock::time_point& start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    std::shared_ptr< XTypeRegistry > make_registry()
+    {
+        auto registry = std::make_shared<XTypeRegistry>();
+        registry->register_class<BenchNode>();
+        registry->set_temporary_policy(TemporaryPolicy::KEEP_NONE);
+        return registry;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t n_nodes = (argc > 1) ? std::stoull(argv[1]) : 1000000;
+    const std::size_t n_threads = (argc > 2) ? std::stoull(argv[2]) : std::max(std::thread::hardware_concurrency(), 1U);
+
+    // Build a binary tree: node i has the nodes 2i+1 and 2i+2 as children
+    auto registry = make_registry();
+    std::vector< XTypePtr > nodes;
+    nodes.reserve(n_nodes);
+    for (std::size_t i = 0; i < n_nodes; ++i)
+    {
+        XTypePtr node = std::make_shared<BenchNode>();
+        node->set_registry_once(registry);
+        node->set_property("name", "node" + std::to_string(i));
+        node->set_property("weight", 0.5 * i);
+        node->set_property("tags", {"bench", "tree"});
+        node->set_all_unknown_facts_empty();
+        if (i > 0)
+            nodes[(i - 1) / 2]->add_fact("children", node);
+        nodes.push_back(node);
+    }
+
+    // JSON lines
+    auto start = Clock::now();
+    std::stringstream json;
+    nodes.front()->export_to_stream(json);
+    const double json_export = seconds_since(start);
+    const std::string json_data(json.str());
+    json.str("");
+    start = Clock::now();
+    {
+        std::stringstream lines(json_data);
+        std::string line;
+        while (std::getline(lines, line))
+            nl::json record(nl::json::parse(line));
+    }
+    const double json_parse = seconds_since(start);
+    start = Clock::now();
+    std::stringstream json_input(json_data);
+    auto json_registry = make_registry();
+    const ImportStats json_stats(XType::import_from_stream(json_input, json_registry));
+    const double json_import = seconds_since(start);
+    start = Clock::now();
+    std::stringstream parallel_input(json_data);
+    const ImportStats parallel_stats(XType::import_from_stream(parallel_input, make_registry(), 0, {}, 1024, n_threads));
+    const double parallel_import = seconds_since(start);
+
+    // Binary
+    start = Clock::now();
+    const std::vector< std::uint8_t > binary(nodes.front()->export_binary());
+    const double binary_export = seconds_since(start);
+    start = Clock::now();
+    {
+        const BinaryGraphReader reader(binary);
+        for (std::size_t i = 0; i < reader.size(); ++i)
+            reader.at(i);
+    }
+    const double binary_parse = seconds_since(start);
+    start = Clock::now();
+    auto binary_registry = make_registry();
+    const std::size_t n_binary = binary_registry->import_binary(binary);
+    const double binary_import = seconds_since(start);
+
+    // Snapshot: Opening only maps the file, the XTypes are materialized on access
+    const std::string snapshot_path("XType_serialization_bench.snapshot");
+    binary_registry->write_snapshot(snapshot_path);
+    start = Clock::now();
+    auto snapshot_registry = make_registry();
+    snapshot_registry->open_snapshot(snapshot_path);
+    const double snapshot_open = seconds_since(start);
+    const std::size_t n_lookups = std::min< std::size_t >(n_nodes, 10000);
+    start = Clock::now();
+    for (std::size_t i = 0; i < n_lookups; ++i)
+        snapshot_registry->get_by_uri(nodes[(i * 7919) % n_nodes]->uri());
+    const double snapshot_lookups = seconds_since(start);
+    std::remove(snapshot_path.c_str());
+
+    if ((json_stats.n_imported != n_nodes) || (parallel_stats.n_imported != n_nodes) || (n_binary != n_nodes))
+        std::cerr << "Unexpected number of imported nodes: " << json_stats.n_imported << " (json) " << parallel_stats.n_imported << " (parallel json) " << n_binary << " (binary)" << std::endl;
+
+    std::cout << "Serialization of " << n_nodes << " nodes" << std::endl;
+    std::cout << std::setw(10) << "format"
+              << std::setw(14) << "bytes"
+              << std::setw(14) << "export [s]"
+              << std::setw(14) << "parse [s]"
+              << std::setw(14) << "import [s]" << std::endl;
+    std::cout << std::setw(10) << "json"
+              << std::setw(14) << json_data.size()
+              << std::setw(14) << std::fixed << std::setprecision(3) << json_export
+              << std::setw(14) << json_parse
+              << std::setw(14) << json_import << std::endl;
+    std::cout << std::setw(10) << "json"
+              << std::setw(14) << "(" + std::to_string(n_threads) + " threads)"
+              << std::setw(14) << "-"
+              << std::setw(14) << "-"
+              << std::setw(14) << parallel_import << std::endl;
+    std::cout << std::setw(10) << "binary"
+              << std::setw(14) << binary.size()
+              << std::setw(14) << binary_export
+              << std::setw(14) << binary_parse
+              << std::setw(14) << binary_import << std::endl;
+    std::cout << "snapshot: open " << snapshot_open << " s, "
+              << static_cast< std::size_t >(n_lookups / snapshot_lookups) << " materializing lookups per second" << std::endl;
+    return 0;
+}
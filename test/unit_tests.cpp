@@ -1,14 +1,166 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 #include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <chrono>
 // Include XTypes
 #include  "XType.hpp"
+#include  "Instrumentation.hpp"
+#include  "Tracing.hpp"
+#include  "utils.hpp"
+#include  "CRC.h"
 
 
 
 
 using namespace xtypes;
 
+namespace {
+    /// An XType with a custom uri built from a property and the facts of a relation (similar to the generated ones)
+    class UriNode : public XType
+    {
+    public:
+        UriNode() : XType("UriNode")
+        {
+            define_property("name", nl::json::value_t::string, {}, "unnamed");
+            define_property("comment", nl::json::value_t::string, {}, "");
+            define_relation("parent", RelationType::CONNECTED_TO, {"UriNode"}, {"UriNode"});
+            set_all_unknown_facts_empty();
+        }
+
+        static inline const std::string classname = "UriNode";
+        mutable int n_builds = 0;
+
+        /// Adds a fact which is only known by its uri and has to be resolved by the registry
+        void add_unresolved_fact(const std::string& name, const std::string& target_uri)
+        {
+            facts.mutate()[name].push_back(ExtendedFact(target_uri, nl::json::object()));
+            facts_changed(name);
+        }
+
+        /// Returns true if the properties and facts are still shared with other (see CopyOnWrite)
+        bool shares_data_with(const UriNode& other) const
+        {
+            return properties.shares_with(other.properties) && facts.shares_with(other.facts);
+        }
+
+    protected:
+        std::string build_uri() const override
+        {
+            n_builds++;
+            std::string url("test://" + get_property("name").get<std::string>());
+            for (const auto& f : facts->at("parent"))
+                url += '/' + std::to_string(uri_to_uuid(f.target_uri()));
+            return url;
+        }
+        const std::set<std::string>& get_uri_properties() const override
+        {
+            static const std::set<std::string> props{"name"};
+            return props;
+        }
+        const std::set<std::string>& get_uri_relations() const override
+        {
+            static const std::set<std::string> rels{"parent"};
+            return rels;
+        }
+    };
+
+    /// An XType which defines its properties and relations only once (similar to the generated ones)
+    class SharedNode : public XType
+    {
+    public:
+        SharedNode() : XType("SharedNode")
+        {
+            if (adopt_class_schema("SharedNode"))
+                return;
+            n_defined++;
+            define_property("name", nl::json::value_t::string, {}, "unnamed");
+            define_relation("peers", RelationType::CONNECTED_TO, {"SharedNode"}, {"SharedNode"});
+            share_class_schema("SharedNode");
+        }
+
+        const ClassSchema* get_schema() const { return schema.get(); }
+
+        static int n_defined;
+    };
+    int SharedNode::n_defined = 0;
+
+    /// An XType whose build_uri() calls uri() on itself (the nested call builds a base uri which is extended)
+    class ReentrantNode : public XType
+    {
+    public:
+        ReentrantNode() : XType("ReentrantNode")
+        {
+            define_property("name", nl::json::value_t::string, {}, "unnamed");
+        }
+
+    protected:
+        std::string build_uri() const override
+        {
+            static thread_local bool nested = false;
+            if (nested)
+                return "test://" + get_property("name").get<std::string>();
+            nested = true;
+            const std::string base(uri());
+            const std::size_t base_uuid(uuid());
+            nested = false;
+            return base + "/" + std::to_string(base_uuid);
+        }
+        const std::set<std::string>& get_uri_properties() const override
+        {
+            static const std::set<std::string> props{"name"};
+            return props;
+        }
+    };
+
+    /// Two XTypes whose relations are the inverse of each other
+    class Assembly : public XType
+    {
+    public:
+        static inline const std::string classname = "Assembly";
+
+        Assembly() : XType(Assembly::classname)
+        {
+            if (adopt_class_schema(Assembly::classname))
+                return;
+            define_property("name", nl::json::value_t::string, {}, "unnamed");
+            HAS("parts", {"Part"});
+            share_class_schema(Assembly::classname);
+        }
+    };
+
+    class Part : public XType
+    {
+    public:
+        static inline const std::string classname = "Part";
+
+        Part() : XType(Part::classname)
+        {
+            if (adopt_class_schema(Part::classname))
+                return;
+            define_property("name", nl::json::value_t::string, {}, "unnamed");
+            HAS("assembly", {"Assembly"}, {}, true);
+            CONNECTED_TO("neighbours", {"Part"});
+            CONNECTED_TO("neighbour_of", {"Part"}, {}, true);
+            share_class_schema(Part::classname);
+        }
+
+    protected:
+        std::string build_uri() const override
+        {
+            return "test://part/" + get_property("name").get<std::string>();
+        }
+        const std::set<std::string>& get_uri_properties() const override
+        {
+            static const std::set<std::string> props{"name"};
+            return props;
+        }
+    };
+}
+
 
 TEST_CASE("Test XType construction and interface", "XType")
 {
@@ -86,6 +238,49 @@ TEST_CASE("Test XType construction and interface", "XType")
     }
 }
 
+TEST_CASE("Test interned classnames", "XType")
+{
+    INFO("Names are interned once");
+    const NameId id(intern_name("InternedName"));
+    REQUIRE(intern_name(std::string("Interned") + "Name") == id);
+    REQUIRE(intern_name("OtherName") != id);
+    REQUIRE(name_of(id) == "InternedName");
+
+    INFO("XTypes of the same class share the interned classname");
+    UriNode a, b;
+    XType c;
+    REQUIRE(a.get_classname_id() == b.get_classname_id());
+    REQUIRE(a.get_classname_id() == intern_name("UriNode"));
+    REQUIRE(a.get_classname_id() != c.get_classname_id());
+    REQUIRE(&a.get_classname() == &b.get_classname());
+    UriNode copy(a);
+    REQUIRE(copy.get_classname() == "UriNode");
+
+    INFO("Relations compare their interned domains");
+    const Relation& rel(a.get_relation("parent"));
+    REQUIRE(rel.from_classnames.ids() == std::vector<NameId>{intern_name("UriNode")});
+    Relation wider(rel);
+    wider.to_classnames.insert("SharedNode");
+    REQUIRE(wider.to_classnames.ids().size() == 2);
+    REQUIRE(wider == rel);
+    Relation other(rel);
+    other.to_classnames = {"SharedNode"};
+    REQUIRE(other != rel);
+    other.to_classnames = {"SharedNode", "UriNode"};
+    other.from_classnames = {"Part"};
+    REQUIRE(other != rel);
+
+    INFO("Reassigning a domain of the same size interns it again");
+    const std::set<std::string> same_size{"Part"};
+    other.from_classnames = same_size;
+    REQUIRE(other.from_classnames.ids() == std::vector<NameId>{intern_name("Part")});
+    other.from_classnames = rel.from_classnames.names();
+    REQUIRE(other == rel);
+    other.to_classnames.erase("UriNode");
+    REQUIRE(other.to_classnames.ids() == std::vector<NameId>{intern_name("SharedNode")});
+    REQUIRE(other != rel);
+}
+
 TEST_CASE("Test Fact construction and usage", "Fact")
 {
     INFO("Construct a Fact");
@@ -106,3 +301,1310 @@ TEST_CASE("Test Fact construction and usage", "Fact")
         i++;
     }
 }
+
+TEST_CASE("Test edge property validation", "Fact")
+{
+    PropertySchema schema;
+    schema.define_property("weight", nl::json::value_t::number_float, {}, 1.0);
+    schema.define_property("mode", nl::json::value_t::string, {"fixed", "free"}, "fixed");
+    schema.define_property("limits/max", nl::json::value_t::number_integer, {}, 10);
+
+    INFO("Valid values are taken over, all others get their defaults");
+    const nl::json expected_defaults = {{"weight", 1.0}, {"mode", "fixed"}, {"limits", {{"max", 10}}}};
+    REQUIRE(schema.validated_values(nl::json()) == expected_defaults);
+    REQUIRE(schema.validated_values(nl::json::object()) == expected_defaults);
+    const nl::json validated(schema.validated_values({{"weight", 2.5}, {"mode", "broken"}, {"limits", {{"max", 3}}}, {"unknown", true}}));
+    REQUIRE(validated == nl::json{{"weight", 2.5}, {"mode", "fixed"}, {"limits", {{"max", 3}}}});
+    REQUIRE(schema.validated_values({{"weight", "heavy"}, {"mode", "free"}})["weight"] == 1.0);
+
+    INFO("Schemata without properties validate to null");
+    REQUIRE(PropertySchema().validated_values({{"weight", 2.5}}).is_null());
+
+    INFO("add_fact() validates the edge properties");
+    XType source;
+    source.define_relation("edges", RelationType::CONNECTED_TO, {"XType"}, {"XType"}, Constraint::MANY2MANY, DeletePolicy::DELETESOURCE, schema);
+    auto target = std::make_shared<XType>();
+    source.add_fact("edges", target, {{"weight", 0.5}, {"mode", "free"}});
+    REQUIRE(source.get_facts("edges").at(0).edge_properties == nl::json{{"weight", 0.5}, {"mode", "free"}, {"limits", {{"max", 10}}}});
+}
+
+TEST_CASE("Test indexed fact storage", "Fact")
+{
+    std::vector< std::shared_ptr<UriNode> > targets;
+    for (int i = 0; i < 5; ++i)
+    {
+        targets.push_back(std::make_shared<UriNode>());
+        targets.back()->set_property("name", "target" + std::to_string(i));
+    }
+
+    INFO("Facts keep their insertion order and are found by target and by uri");
+    FactList facts;
+    for (const auto& target : targets)
+        facts.push_back(ExtendedFact(target, nullptr));
+    facts.push_back(ExtendedFact("test://unresolved", nullptr));
+    REQUIRE(facts.size() == 6);
+    std::size_t i = 0;
+    for (const auto& fact : facts)
+    {
+        if (i < targets.size())
+            REQUIRE(fact.target.lock() == targets[i]);
+        i++;
+    }
+    REQUIRE(facts.find(ExtendedFact(targets[3], nullptr)) != FactList::npos);
+    REQUIRE(facts.get(facts.find(ExtendedFact(targets[3], nullptr))).target.lock() == targets[3]);
+    REQUIRE(facts.contains(ExtendedFact("test://target2", nullptr)));
+    REQUIRE(facts.contains(ExtendedFact("test://unresolved", nullptr)));
+    auto copy_of_target = std::make_shared<UriNode>(*targets[1]);
+    REQUIRE(facts.contains(ExtendedFact(copy_of_target, nullptr)));
+    REQUIRE(!facts.contains(ExtendedFact("test://unknown", nullptr)));
+
+    INFO("Removed facts leave no trace");
+    REQUIRE(facts.remove(ExtendedFact(targets[1], nullptr)) == 1);
+    REQUIRE(facts.remove(ExtendedFact(targets[1], nullptr)) == 0);
+    REQUIRE(facts.size() == 5);
+    REQUIRE(!facts.contains(ExtendedFact("test://target1", nullptr)));
+    REQUIRE(facts.remove(ExtendedFact(targets[0], nullptr)) == 1);
+    REQUIRE(facts.remove(ExtendedFact(targets[2], nullptr)) == 1);
+    REQUIRE(facts.remove(ExtendedFact(targets[3], nullptr)) == 1);
+    REQUIRE(facts.size() == 2);
+    REQUIRE(facts.begin()->target.lock() == targets[4]);
+    REQUIRE(facts.contains(ExtendedFact(targets[4], nullptr)));
+    REQUIRE(facts.contains(ExtendedFact("test://unresolved", nullptr)));
+
+    INFO("Facts are still found after the uri of their target has changed");
+    auto node = std::make_shared<UriNode>();
+    node->add_fact("parent", targets[4]);
+    targets[4]->set_property("name", "renamed");
+    auto renamed = std::make_shared<UriNode>();
+    renamed->set_property("name", "renamed");
+    node->add_fact("parent", renamed);
+    REQUIRE(node->get_facts("parent").size() == 1);
+    node->remove_fact("parent", renamed);
+    REQUIRE(node->get_facts("parent").empty());
+
+    INFO("Hubs with many facts");
+    auto hub = std::make_shared<UriNode>();
+    std::vector< XTypePtr > leaves;
+    for (int j = 0; j < 2000; ++j)
+    {
+        leaves.push_back(std::make_shared<UriNode>());
+        leaves.back()->set_property("name", "leaf" + std::to_string(j));
+        hub->add_fact("parent", leaves.back());
+        hub->add_fact("parent", leaves.back());
+    }
+    REQUIRE(hub->get_facts("parent").size() == 2000);
+    for (int j = 0; j < 2000; j += 2)
+        hub->remove_fact("parent", leaves[j]);
+    const std::vector< Fact > remaining(hub->get_facts("parent"));
+    REQUIRE(remaining.size() == 1000);
+    REQUIRE(remaining.front().target.lock() == leaves[1]);
+    REQUIRE(remaining.back().target.lock() == leaves[1999]);
+
+    INFO("Renames in between the construction of a hub only refresh the facts of the renamed targets");
+    auto part_hub = std::make_shared<Part>();
+    part_hub->set_all_unknown_facts_empty();
+    std::vector< std::shared_ptr<Part> > parts;
+    const int n_parts = 20000;
+    for (int j = 0; j < n_parts; ++j)
+    {
+        parts.push_back(std::make_shared<Part>());
+        parts.back()->set_all_unknown_facts_empty();
+        parts.back()->set_property("name", "part" + std::to_string(j));
+        part_hub->add_fact("neighbours", parts.back());
+        // Rename an already linked part and an unrelated one
+        if (j % 10 == 9)
+            parts[j / 2]->set_property("name", "renamed" + std::to_string(j));
+        Part unrelated;
+        unrelated.set_property("name", "unrelated" + std::to_string(j));
+        unrelated.uri();
+        unrelated.set_property("name", "still unrelated" + std::to_string(j));
+    }
+    REQUIRE(part_hub->get_facts("neighbours").size() == n_parts);
+    for (int j = 9; j < n_parts; j += 10)
+    {
+        // A copy has the new uri, but is another object, so it is only found by the uri
+        auto copy = std::make_shared<Part>(*parts[j / 2]);
+        part_hub->add_fact("neighbours", copy);
+    }
+    REQUIRE(part_hub->get_facts("neighbours").size() == n_parts);
+
+    INFO("Facts of targets whose uri is built from facts are found after their dependencies have been renamed");
+    auto grandparent = std::make_shared<UriNode>();
+    grandparent->set_property("name", "grandparent");
+    auto parent = std::make_shared<UriNode>();
+    parent->set_property("name", "parent");
+    parent->add_fact("parent", grandparent);
+    auto child = std::make_shared<UriNode>();
+    child->add_fact("parent", parent);
+    grandparent->set_property("name", "renamed grandparent");
+    auto parent_copy = std::make_shared<UriNode>(*parent);
+    REQUIRE(parent_copy->uri() == parent->uri());
+    child->add_fact("parent", parent_copy);
+    REQUIRE(child->get_facts("parent").size() == 1);
+
+    INFO("Committing an unchanged instance again does not log an uri change");
+    auto registry = std::make_shared<XTypeRegistry>();
+    registry->register_class<Part>();
+    REQUIRE(registry->commit(parts[0], true));
+    XTypePtr checked_out = registry->get_by_uri(parts[0]->uri());
+    REQUIRE(checked_out);
+    const std::uint64_t epoch(XType::uri_epoch());
+    for (int j = 0; j < 100; ++j)
+        REQUIRE(registry->commit(parts[0], true));
+    REQUIRE(registry->get_by_uri(parts[0]->uri())->uri() == parts[0]->uri());
+    REQUIRE(XType::uri_epoch() == epoch);
+}
+
+TEST_CASE("Test precomputed inverse relations", "XTypeRegistry")
+{
+    auto registry = std::make_shared<XTypeRegistry>();
+    registry->register_class<Assembly>();
+    registry->register_class<Part>();
+    XTypePtr assembly(registry->instantiate<Assembly>());
+    XTypePtr part(registry->instantiate<Part>());
+    XTypePtr other_part(registry->instantiate<Part>());
+    assembly->set_all_unknown_facts_empty();
+    part->set_all_unknown_facts_empty();
+    other_part->set_all_unknown_facts_empty();
+
+    INFO("The registry knows the matching relations of registered classes");
+    const std::vector<std::string>* matches = registry->find_inverse_relations(*assembly, "parts", *part);
+    REQUIRE(matches);
+    REQUIRE(*matches == std::vector<std::string>{"assembly"});
+    REQUIRE(*registry->find_inverse_relations(*part, "assembly", *assembly) == std::vector<std::string>{"parts"});
+    REQUIRE(*registry->find_inverse_relations(*part, "neighbours", *other_part) == std::vector<std::string>{"neighbour_of"});
+    REQUIRE(registry->find_inverse_relations(*part, "neighbours", *assembly)->empty());
+    REQUIRE(!registry->find_inverse_relations(*assembly, "unknown", *part));
+    REQUIRE(!registry->find_inverse_relations(*assembly, "parts", UriNode()));
+
+    INFO("Inverse facts are auto-filled by the table");
+    part->set_property("name", "part");
+    assembly->add_fact("parts", part);
+    REQUIRE(part->get_facts("assembly").size() == 1);
+    REQUIRE(part->get_facts("assembly").front().target.lock() == assembly);
+    other_part->set_property("name", "other part");
+    part->add_fact("neighbours", other_part);
+    REQUIRE(other_part->get_facts("neighbour_of").size() == 1);
+
+    INFO("Imported classes are known as well");
+    auto other_registry = std::make_shared<XTypeRegistry>();
+    other_registry->import_from(*registry);
+    REQUIRE(*other_registry->find_inverse_relations(*assembly, "parts", *part) == std::vector<std::string>{"assembly"});
+
+    INFO("XTypes with relations defined at runtime fall back to comparing the relations");
+    XTypePtr extended(registry->instantiate<Part>());
+    extended->set_property("name", "extended");
+    extended->CONNECTED_TO("extra", {"Part"}, {}, true);
+    extended->set_all_unknown_facts_empty();
+    REQUIRE(!registry->find_inverse_relations(*extended, "extra", *part));
+    extended->add_fact("extra", part);
+    REQUIRE(part->get_facts("neighbours").size() == 2);
+}
+
+TEST_CASE("Test cached URI and UUID", "XType")
+{
+    auto parent = std::make_shared<UriNode>();
+    auto child = std::make_shared<UriNode>();
+    parent->set_property("name", "parent");
+    child->set_property("name", "child");
+
+    INFO("The uri is only built once as long as nothing changes");
+    const std::string child_uri(child->uri());
+    REQUIRE(child_uri == "test://child");
+    REQUIRE(child->uuid() == uri_to_uuid(child_uri));
+    const int n_builds = child->n_builds;
+    REQUIRE(child->uri() == child_uri);
+    REQUIRE(child->n_builds == n_builds);
+
+    INFO("Properties which are not part of the uri do not invalidate the cache");
+    child->set_property("comment", "does not matter");
+    REQUIRE(child->uri() == child_uri);
+    REQUIRE(child->n_builds == n_builds);
+
+    INFO("Properties and facts which are part of the uri do");
+    child->set_property("name", "renamed");
+    REQUIRE(child->uri() == "test://renamed");
+    child->add_fact("parent", parent);
+    REQUIRE(child->uri() == "test://renamed/" + std::to_string(parent->uuid()));
+    REQUIRE(child->uuid() == uri_to_uuid(child->uri()));
+
+    INFO("Changes of the uri of a fact target propagate");
+    const std::uint64_t revision = child->uri_revision();
+    parent->set_property("name", "another parent");
+    REQUIRE(child->uri() == "test://renamed/" + std::to_string(parent->uuid()));
+    REQUIRE(child->uri_revision() != revision);
+    child->remove_fact("parent", parent);
+    REQUIRE(child->uri() == "test://renamed");
+
+    INFO("build_uri() may call uri() and uuid() on the same XType");
+    ReentrantNode reentrant;
+    reentrant.set_property("name", "nested");
+    const std::string nested_uri("test://nested/" + std::to_string(uri_to_uuid("test://nested")));
+    REQUIRE(reentrant.uri() == nested_uri);
+    REQUIRE(reentrant.uuid() == uri_to_uuid(nested_uri));
+    REQUIRE(reentrant.is_uri_valid());
+}
+
+TEST_CASE("Test uuid schemes", "XType")
+{
+    // Bitwise reference implementation of a reflected CRC
+    auto reference = [](const std::string& data, const std::uint64_t polynomial, const std::uint64_t mask) {
+        std::uint64_t crc = mask;
+        for (const unsigned char c : data)
+        {
+            crc ^= c;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc & 1) ? (crc >> 1) ^ polynomial : (crc >> 1);
+        }
+        return ~crc & mask;
+    };
+
+    INFO("The schemes give the standard check values");
+    const std::string check("123456789");
+    REQUIRE(uri_to_uuid(check, UuidScheme::CRC32) == 0xCBF43926U);
+    REQUIRE(uri_to_uuid(check, UuidScheme::CRC32C) == 0xE3069283U);
+    REQUIRE(uri_to_uuid(check, UuidScheme::CRC64) == 0x995DC9BBDF1939FAULL);
+
+    INFO("All lengths and alignments match the reference (and CRC32 the former implementation)");
+    std::string data;
+    for (std::size_t i = 0; i < 100; ++i)
+        data += static_cast< char >((i * 131) ^ (i >> 2));
+    for (std::size_t offset = 0; offset < 8; ++offset)
+    {
+        for (std::size_t size = 0; offset + size <= data.size(); ++size)
+        {
+            const std::string part(data.substr(offset, size));
+            REQUIRE(hashing::crc32(data.data() + offset, size) == CRC::Calculate(part.data(), part.size(), CRC::CRC_32()));
+            REQUIRE(hashing::crc32(data.data() + offset, size) == reference(part, 0xEDB88320U, 0xFFFFFFFFU));
+            REQUIRE(hashing::crc32c(data.data() + offset, size) == reference(part, 0x82F63B78U, 0xFFFFFFFFU));
+            REQUIRE(hashing::crc64(data.data() + offset, size) == reference(part, 0xC96C5795D7870F42ULL, ~0ULL));
+        }
+    }
+
+    INFO("uri_to_uuid() uses CRC32 unless another scheme has been selected");
+    const std::string uri("test://some/uri");
+    REQUIRE(get_uuid_scheme() == UuidScheme::CRC32);
+    REQUIRE(uri_to_uuid(uri) == CRC::Calculate(uri.data(), uri.size(), CRC::CRC_32()));
+    set_uuid_scheme(UuidScheme::CRC64);
+    REQUIRE(get_uuid_scheme() == UuidScheme::CRC64);
+    REQUIRE(uri_to_uuid(uri) == hashing::crc64(uri.data(), uri.size()));
+    set_uuid_scheme(UuidScheme::CRC32);
+    REQUIRE(uri_to_uuid(uri) == hashing::crc32(uri.data(), uri.size()));
+}
+
+TEST_CASE("Test property access by precompiled keys", "XType")
+{
+    XType my_xtype;
+    my_xtype.define_property("a property", nl::json::value_t::string, {}, "a value");
+    my_xtype.define_property("direction", nl::json::value_t::string, {"in","out"}, "out");
+    my_xtype.define_property("a/nested/property", nl::json::value_t::string, {}, "with a value");
+    const PropertyKey key("a property");
+    const PropertyKey direction("/direction");
+    const PropertyKey nested("a/nested/property");
+
+    INFO("Precompiled keys and paths address the same values");
+    REQUIRE(my_xtype.get_property_by_key(key) == "a value");
+    my_xtype.set_property_by_key(key, "another value");
+    REQUIRE(my_xtype.get_property("a property") == "another value");
+    my_xtype.set_property("/a property", "yet another value");
+    REQUIRE(my_xtype.get_property_by_key(key) == "yet another value");
+    REQUIRE(my_xtype.get_property_by_key(nested) == "with a value");
+
+    INFO("Type and allowed values are checked");
+    REQUIRE_THROWS(my_xtype.set_property_by_key(key, 1));
+    REQUIRE_THROWS(my_xtype.set_property_by_key(direction, "left"));
+    REQUIRE_NOTHROW(my_xtype.set_property_by_key(direction, "in"));
+    REQUIRE(my_xtype.get_property("direction") == "in");
+
+    INFO("Intermediate keys have no slot but can still be read");
+    REQUIRE(my_xtype.get_property_by_key(PropertyKey("a/nested")) == nl::json{{"property", "with a value"}});
+    REQUIRE_THROWS(my_xtype.get_property_by_key(PropertyKey("not defined")));
+
+    INFO("Copies do not refer to the values of the original");
+    XType copy(my_xtype);
+    copy.set_property_by_key(key, "a copied value");
+    REQUIRE(copy.get_property_by_key(key) == "a copied value");
+    REQUIRE(my_xtype.get_property_by_key(key) == "yet another value");
+
+    INFO("Redefinition replaces nested properties");
+    my_xtype.define_property("a/nested", nl::json::value_t::number_integer, {}, 1, true);
+    REQUIRE(!my_xtype.has_property("a/nested/property"));
+    REQUIRE(my_xtype.get_property("a/nested") == 1);
+}
+
+TEST_CASE("Test shared class schema", "XType")
+{
+    SharedNode first;
+    SharedNode second;
+    REQUIRE(SharedNode::n_defined == 1);
+
+    INFO("Instances of the same class share their definitions but not their values");
+    REQUIRE(first.get_schema() == second.get_schema());
+    REQUIRE(second.has_relation("peers"));
+    REQUIRE(second.get_property("name") == "unnamed");
+    first.set_property("name", "first");
+    REQUIRE(second.get_property("name") == "unnamed");
+
+    INFO("Definitions at runtime only affect the defining instance");
+    second.define_property("extra", nl::json::value_t::number_integer, {}, 1);
+    REQUIRE(first.get_schema() != second.get_schema());
+    REQUIRE(second.has_property("extra"));
+    REQUIRE(!first.has_property("extra"));
+    REQUIRE(!SharedNode().has_property("extra"));
+}
+
+TEST_CASE("Test uri interning", "UriTable")
+{
+    UriTable table;
+    REQUIRE(table.find("test://a") == UriTable::npos);
+    const UriHandle a = table.intern("test://a");
+    const UriHandle b = table.intern("test://b");
+    REQUIRE(a != b);
+    REQUIRE(table.intern("test://a") == a);
+    REQUIRE(table.find("test://b") == b);
+    REQUIRE(table.at(a) == "test://a");
+
+    INFO("Handles stay the same while the table grows");
+    for (int i = 0; i < 1000; ++i)
+        table.intern("test://" + std::to_string(i));
+    REQUIRE(table.size() == 1002);
+    REQUIRE(table.find("test://a") == a);
+    REQUIRE(table.find("test://999") == table.intern("test://999"));
+
+    INFO("Erased uris release their handles for reuse");
+    REQUIRE(table.erase("test://a"));
+    REQUIRE(!table.erase("test://a"));
+    REQUIRE(table.find("test://a") == UriTable::npos);
+    REQUIRE(table.find("test://b") == b);
+    REQUIRE(table.size() == 1001);
+    REQUIRE(table.intern("test://c") == a);
+    REQUIRE(table.at(a) == "test://c");
+    REQUIRE(table.capacity() == 1002);
+
+    INFO("Dropping and interning uris over and over does not grow the table");
+    std::size_t n_erased = 0;
+    for (int round = 0; round < 50; ++round)
+    {
+        for (int i = 0; i < 1000; ++i)
+            n_erased += table.erase("test://" + std::to_string(round * 1000 + i));
+        for (int i = 0; i < 1000; ++i)
+            table.intern("test://" + std::to_string((round + 1) * 1000 + i));
+    }
+    REQUIRE(n_erased == 50000);
+    REQUIRE(table.size() == 1002);
+    REQUIRE(table.capacity() == 1002);
+    REQUIRE(table.find("test://b") == b);
+    REQUIRE(table.find("test://50999") != UriTable::npos);
+    REQUIRE(table.find("test://999") == UriTable::npos);
+    table.clear();
+    REQUIRE(table.find("test://c") == UriTable::npos);
+}
+
+TEST_CASE("Test registry lookups by uri", "XTypeRegistry")
+{
+    auto registry = std::make_shared<XTypeRegistry>();
+    registry->register_class<UriNode>();
+    XTypePtr node = registry->instantiate_from("UriNode");
+    node->set_property("name", "node");
+    REQUIRE(!registry->knows_uri(node->uri()));
+    REQUIRE(registry->get_by_uri(node->uri()) == nullptr);
+    REQUIRE(registry->commit(node, true));
+    REQUIRE(registry->knows_uri("test://node"));
+
+    INFO("A temporary copy is handed out for a known uri");
+    XTypePtr copy = registry->get_by_uri("test://node");
+    REQUIRE(copy);
+    REQUIRE(copy != node);
+    REQUIRE(copy->uri() == "test://node");
+    REQUIRE(registry->get_by_uri("test://node") == copy);
+
+    INFO("Overwriting commits do not modify the temporary copies handed out before");
+    XTypePtr update = registry->instantiate_from("UriNode");
+    update->set_property("name", "node");
+    update->set_property("comment", "updated");
+    REQUIRE(registry->commit(update, true));
+    REQUIRE(copy->get_property("comment") == "");
+    XTypePtr fresh = registry->get_by_uri("test://node");
+    REQUIRE(fresh != copy);
+    REQUIRE(fresh->get_property("comment") == "updated");
+    REQUIRE(registry->get_by_uri("test://node") == fresh);
+    copy = fresh;
+
+    INFO("A renamed copy can be found by its old and new uri");
+    copy->set_property("name", "renamed");
+    REQUIRE(registry->get_by_uri("test://node") == copy);
+    REQUIRE(registry->get_by_uri("test://renamed") == copy);
+    REQUIRE(!registry->knows_uri("test://renamed"));
+
+    registry->drop("test://node");
+    REQUIRE(!registry->knows_uri("test://node"));
+    REQUIRE(registry->get_by_uri("test://node") == nullptr);
+
+    INFO("A dropped uri can be committed again");
+    XTypePtr again = registry->instantiate_from("UriNode");
+    again->set_property("name", "node");
+    REQUIRE(registry->commit(again, true));
+    REQUIRE(registry->knows_uri("test://node"));
+    REQUIRE(registry->get_by_uri("test://node") != copy);
+    registry->clear();
+    REQUIRE(registry->get_by_uri("test://renamed") == nullptr);
+}
+
+TEST_CASE("Test concurrent registry usage", "XTypeRegistry")
+{
+    const int n_threads = 8;
+    const int n_instances = 500;
+    auto registry = std::make_shared<XTypeRegistry>(16);
+    registry->register_class<UriNode>();
+    std::atomic<int> n_failures{0};
+
+    INFO("Threads commit disjoint instances and resolve uris of the others in parallel");
+    std::vector< std::thread > threads;
+    for (int t = 0; t < n_threads; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < n_instances; ++i)
+            {
+                XTypePtr node = registry->instantiate_from("UriNode");
+                node->set_property("name", std::to_string(t) + "_" + std::to_string(i));
+                if (!registry->commit(node, true))
+                    n_failures++;
+                XTypePtr copy = registry->get_by_uri(node->uri());
+                if (!copy || copy->uri() != node->uri())
+                    n_failures++;
+                // Commit an uri again which the other threads might resolve right now
+                if (i > 0)
+                {
+                    XTypePtr again = registry->instantiate_from("UriNode");
+                    again->set_property("name", std::to_string(t) + "_" + std::to_string(i - 1));
+                    if (!registry->commit(again, true))
+                        n_failures++;
+                }
+                // Resolve uris which the other threads are committing
+                for (int other = 0; other < n_threads; ++other)
+                {
+                    if (other == t)
+                        continue;
+                    const std::string other_uri("test://" + std::to_string(other) + "_" + std::to_string(i > 0 ? i - 1 : i));
+                    XTypeCPtr resolved = registry->get_by_uri(other_uri);
+                    // NOTE: The other thread might not have committed it yet
+                    if (resolved && resolved->uri() != other_uri)
+                        n_failures++;
+                    registry->knows_uri(other_uri);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    REQUIRE(n_failures == 0);
+    int n_known = 0;
+    for (int t = 0; t < n_threads; ++t)
+        for (int i = 0; i < n_instances; ++i)
+            n_known += registry->knows_uri("test://" + std::to_string(t) + "_" + std::to_string(i));
+    REQUIRE(n_known == n_threads * n_instances);
+}
+
+TEST_CASE("Test bounded temporary instances", "XTypeRegistry")
+{
+    auto registry = std::make_shared<XTypeRegistry>();
+    registry->register_class<UriNode>();
+    REQUIRE(registry->get_temporary_policy() == TemporaryPolicy::STRONG);
+
+    INFO("STRONG keeps every instance alive");
+    std::weak_ptr<XType> strong_node = registry->instantiate_from("UriNode");
+    REQUIRE(!strong_node.expired());
+    REQUIRE(registry->get_temporary_stats().tracked == 1);
+
+    INFO("Switching to WEAK releases the instances nobody else holds");
+    registry->set_temporary_policy(TemporaryPolicy::WEAK);
+    REQUIRE(strong_node.expired());
+    const int n_instances = 5000;
+    for (int i = 0; i < n_instances; ++i)
+    {
+        XTypePtr node = registry->instantiate_from("UriNode");
+        node->set_property("name", std::to_string(i));
+        REQUIRE(registry->commit(node, true));
+    }
+    TemporaryStats stats = registry->get_temporary_stats();
+    REQUIRE(stats.created == n_instances + 1);
+    REQUIRE(stats.compactions > 0);
+    REQUIRE(stats.tracked < 2048);
+    registry->compact_temporary_instances();
+    stats = registry->get_temporary_stats();
+    REQUIRE(stats.tracked == 0);
+    REQUIRE(stats.reclaimed == n_instances + 1);
+
+    INFO("Committed instances stay resolvable as long as the caller holds the temporary copy");
+    XTypePtr copy = registry->get_by_uri("test://42");
+    REQUIRE(copy);
+    REQUIRE(registry->get_by_uri("test://42") == copy);
+    REQUIRE(registry->get_temporary_stats().tracked == 1);
+
+    INFO("KEEP_NONE does not track at all");
+    registry->set_temporary_policy(TemporaryPolicy::KEEP_NONE);
+    XTypePtr untracked = registry->instantiate_from("UriNode");
+    REQUIRE(untracked);
+    REQUIRE(registry->get_temporary_stats().tracked == 0);
+    REQUIRE(registry->get_by_uri("test://42") == copy);
+
+    INFO("Switching back to STRONG takes over the alive instances");
+    registry->set_temporary_policy(TemporaryPolicy::WEAK);
+    XTypePtr alive = registry->instantiate_from("UriNode");
+    registry->set_temporary_policy(TemporaryPolicy::STRONG);
+    REQUIRE(registry->get_temporary_stats().tracked == 1);
+}
+
+TEST_CASE("Test traversal without tracked temporaries", "XTypeRegistry")
+{
+    for (const TemporaryPolicy policy : {TemporaryPolicy::WEAK, TemporaryPolicy::KEEP_NONE})
+    {
+        auto registry = std::make_shared<XTypeRegistry>();
+        registry->register_class<Part>();
+        registry->set_temporary_policy(policy);
+
+        INFO("A ring of parts which only the registry holds (as committed instances)");
+        const int n_parts = 6;
+        {
+            std::vector< XTypePtr > parts;
+            for (int i = 0; i < n_parts; ++i)
+            {
+                parts.push_back(registry->instantiate_from(Part::classname));
+                parts.back()->set_property("name", "p" + std::to_string(i));
+            }
+            for (int i = 0; i < n_parts; ++i)
+                parts[i]->add_fact("neighbours", parts[(i + 1) % n_parts]);
+            for (const auto& part : parts)
+                REQUIRE(registry->commit(part, true));
+        }
+
+        INFO("get_facts() keeps the resolved targets alive for the caller");
+        XTypePtr root = registry->get_by_uri("test://part/p0");
+        REQUIRE(root);
+        std::weak_ptr< XType > weak_root = root;
+        {
+            const PinnedFacts facts(root->get_facts("neighbours"));
+            REQUIRE(facts.size() == 1);
+            REQUIRE(facts.targets.size() == 1);
+            REQUIRE(facts.targets[0]);
+            REQUIRE(facts[0].target.lock() == facts.targets[0]);
+            REQUIRE(facts.targets[0]->uri() == "test://part/p1");
+            REQUIRE(facts.targets[0]->get_facts("neighbours").targets.at(0)->uri() == "test://part/p2");
+        }
+
+        INFO("export_to() visits the whole ring");
+        const std::map< std::string, nl::json > exported(root->export_to());
+        REQUIRE(exported.size() == n_parts);
+        for (int i = 0; i < n_parts; ++i)
+            REQUIRE(exported.count("test://part/p" + std::to_string(i)) == 1);
+
+        INFO("The stored facts do not pin their targets, so the ring expires");
+        root.reset();
+        REQUIRE(weak_root.expired());
+    }
+}
+
+TEST_CASE("Test batch commit and uri resolution", "XTypeRegistry")
+{
+    auto registry = std::make_shared<XTypeRegistry>(4);
+    registry->register_class<UriNode>();
+
+    INFO("commit_many() skips instances without a valid uri");
+    std::vector< XTypePtr > nodes;
+    for (const std::string name : {"a", "b", "c"})
+    {
+        nodes.push_back(registry->instantiate_from("UriNode"));
+        nodes.back()->set_property("name", name);
+    }
+    nodes.push_back(nullptr);
+    REQUIRE(registry->commit_many(nodes, true) == 3);
+    REQUIRE(registry->knows_uri("test://a"));
+    REQUIRE(registry->knows_uri("test://c"));
+
+    INFO("load_many() passes all unknown uris to the load_many_func at once");
+    std::vector< std::vector< std::string > > requests;
+    registry->set_load_many_func([&](const std::vector< std::string >& uris) {
+        requests.push_back(uris);
+        std::vector< XTypePtr > loaded;
+        for (const auto& uri : uris)
+        {
+            if (uri == "test://unknown")
+                continue;
+            XTypePtr node = std::make_shared<UriNode>();
+            node->set_property("name", uri.substr(7));
+            loaded.push_back(node);
+        }
+        return loaded;
+    });
+    const std::vector< XTypePtr > loaded(registry->load_many({"test://a", "test://x", "test://unknown", "test://y", "test://x"}));
+    REQUIRE(requests.size() == 1);
+    REQUIRE(requests[0].size() == 3);
+    REQUIRE(loaded.size() == 5);
+    REQUIRE(loaded[0]->uri() == "test://a");
+    REQUIRE(loaded[1]->uri() == "test://x");
+    REQUIRE(loaded[2] == nullptr);
+    REQUIRE(loaded[3]->uri() == "test://y");
+    REQUIRE(loaded[4] == loaded[1]);
+    REQUIRE(registry->knows_uri("test://y"));
+
+    INFO("load_by_uri() uses the load_many_func if there is no load_func");
+    REQUIRE(registry->load_by_uri("test://z")->uri() == "test://z");
+    REQUIRE(requests.size() == 2);
+
+    INFO("get_facts() resolves all unresolved facts of a relation in one batch");
+    auto child = std::make_shared<UriNode>();
+    child->set_registry_once(registry);
+    child->set_property("name", "child");
+    for (const std::string uri : {"test://p1", "test://p2", "test://p3"})
+        child->add_unresolved_fact("parent", uri);
+    const std::vector< Fact > parents(child->get_facts("parent"));
+    REQUIRE(requests.size() == 3);
+    REQUIRE(requests[2].size() == 3);
+    REQUIRE(parents.size() == 3);
+    REQUIRE(parents[1].target.lock()->uri() == "test://p2");
+}
+
+TEST_CASE("Test asynchronous fact resolution and prefetching", "XTypeRegistry")
+{
+    auto registry = std::make_shared<XTypeRegistry>(4);
+    registry->register_class<UriNode>();
+    // The load_func creates a node without parents for every uri and records the requests
+    std::mutex mutex;
+    std::vector< std::string > requested;
+    registry->set_load_func([&](const std::string& uri) -> XTypePtr {
+        {
+            std::lock_guard< std::mutex > lock(mutex);
+            requested.push_back(uri);
+        }
+        auto node = std::make_shared<UriNode>();
+        node->set_property("name", uri.substr(7));
+        return node;
+    });
+
+    INFO("get_facts_async() loads all pending targets concurrently");
+    auto child = std::make_shared<UriNode>();
+    child->set_registry_once(registry);
+    child->set_property("name", "child");
+    for (const std::string uri : {"test://p1", "test://p2", "test://p3"})
+        child->add_unresolved_fact("parent", uri);
+    REQUIRE(child->get_unresolved_uris().size() == 3);
+    std::future< PinnedFacts > pending(child->get_facts_async("parent"));
+    const std::vector< Fact > parents(pending.get());
+    REQUIRE(parents.size() == 3);
+    REQUIRE(parents[2].target.lock()->uri() == "test://p3");
+    REQUIRE(requested.size() == 3);
+    REQUIRE(child->get_unresolved_uris().empty());
+
+    INFO("load_many_async() delivers the results in order");
+    const std::vector< XTypePtr > loaded(registry->load_many_async({"test://q", "test://p1"}).get());
+    REQUIRE(loaded[0]->uri() == "test://q");
+    REQUIRE(loaded[1]->uri() == "test://p1");
+    REQUIRE(requested.size() == 4);
+
+    INFO("Touching a node prefetches the neighbours of its targets");
+    auto grandparent = std::make_shared<UriNode>();
+    grandparent->set_property("name", "grandparent");
+    auto parent = std::make_shared<UriNode>();
+    parent->set_property("name", "parent");
+    parent->add_unresolved_fact("parent", "test://grandparent");
+    const std::string parent_uri(parent->uri());
+    REQUIRE(registry->commit(parent, true));
+    registry->set_prefetch_depth(1);
+    REQUIRE(registry->get_prefetch_depth() == 1);
+    auto leaf = std::make_shared<UriNode>();
+    leaf->set_registry_once(registry);
+    leaf->set_property("name", "leaf");
+    leaf->add_unresolved_fact("parent", parent_uri);
+    leaf->get_facts("parent");
+    registry->wait_for_prefetches();
+    REQUIRE(registry->knows_uri("test://grandparent"));
+    REQUIRE(requested.back() == "test://grandparent");
+
+    INFO("Prefetches are bounded and stopped when the registry is released");
+    std::atomic<std::size_t> n_loads{0};
+    // NOTE: The loads wait until all prefetches have been issued, so that no queued prefetch is done in the meantime
+    std::atomic<bool> issued{false};
+    std::weak_ptr<XTypeRegistry> released;
+    {
+        auto other = std::make_shared<XTypeRegistry>();
+        released = other;
+        other->register_class<UriNode>();
+        other->set_load_func([&n_loads, &issued](const std::string& uri) -> XTypePtr {
+            n_loads++;
+            while (!issued)
+                std::this_thread::yield();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            auto node = std::make_shared<UriNode>();
+            node->set_property("name", uri.substr(7));
+            return node;
+        });
+        std::vector< std::string > uris;
+        for (int i = 0; i < 200; ++i)
+        {
+            auto node = std::make_shared<UriNode>();
+            node->set_property("name", "p" + std::to_string(i));
+            node->add_unresolved_fact("parent", "test://g" + std::to_string(i));
+            uris.push_back(node->uri());
+            REQUIRE(other->commit(node, true));
+        }
+        for (const auto& uri : uris)
+            other->prefetch({uri}, 2);
+        // NOTE: We do not wait for the prefetches here
+        issued = true;
+    }
+    // A running prefetch finishes its current hop before the registry is destroyed
+    while (!released.expired())
+        std::this_thread::yield();
+    // Every prefetch loads one node, but only the queued and running ones have been executed
+    REQUIRE(n_loads.load() <= XTypeRegistry::max_queued_prefetches + XTypeRegistry::max_prefetch_threads);
+}
+
+TEST_CASE("Test bounded asynchronous loads", "XTypeRegistry")
+{
+    auto registry = std::make_shared<XTypeRegistry>(4);
+    registry->register_class<UriNode>();
+    // The load_func takes a while and records how many calls overlap
+    std::mutex mutex;
+    std::size_t n_running = 0;
+    std::size_t max_running = 0;
+    registry->set_load_func([&](const std::string& uri) -> XTypePtr {
+        {
+            std::lock_guard< std::mutex > lock(mutex);
+            max_running = std::max(max_running, ++n_running);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        auto node = std::make_shared<UriNode>();
+        node->set_property("name", uri.substr(7));
+        {
+            std::lock_guard< std::mutex > lock(mutex);
+            n_running--;
+        }
+        return node;
+    });
+
+    INFO("load_many_async() does not start a thread per uri");
+    std::vector< std::string > uris;
+    for (int i = 0; i < 200; ++i)
+        uris.push_back("test://hub" + std::to_string(i));
+    const std::vector< XTypePtr > loaded(registry->load_many_async(uris).get());
+    REQUIRE(loaded.size() == uris.size());
+    for (std::size_t i = 0; i < uris.size(); ++i)
+        REQUIRE(loaded[i]->uri() == uris[i]);
+    REQUIRE(max_running > 0);
+    REQUIRE(max_running <= XTypeRegistry::max_load_threads);
+}
+
+TEST_CASE("Test streaming export", "XType")
+{
+    auto registry = std::make_shared<XTypeRegistry>();
+    registry->register_class<UriNode>();
+    XTypePtr root = registry->instantiate_from("UriNode");
+    root->set_property("name", "root");
+    XTypePtr child = registry->instantiate_from("UriNode");
+    child->set_property("name", "child");
+    child->add_fact("parent", root);
+    XTypePtr grandchild = registry->instantiate_from("UriNode");
+    grandchild->set_property("name", "grandchild");
+    grandchild->add_fact("parent", child);
+
+    INFO("The writer receives the same records as export_to() and every xtype only once");
+    const std::map< std::string, nl::json > expected(grandchild->export_to());
+    REQUIRE(expected.size() == 3);
+    std::vector< std::string > order;
+    std::map< std::string, nl::json > written;
+    const std::size_t n_exported = grandchild->export_to_writer([&](const std::string& uri, const nl::json& record) {
+        order.push_back(uri);
+        written[uri] = record;
+    });
+    REQUIRE(n_exported == 3);
+    REQUIRE(written == expected);
+    REQUIRE(order.front() == grandchild->uri());
+    REQUIRE(order.back() == root->uri());
+
+    INFO("The depth limit is respected");
+    REQUIRE(grandchild->export_to_writer([](const std::string&, const nl::json&) {}, 1) == 2);
+
+    INFO("A stream receives one JSON document per line");
+    std::stringstream stream;
+    REQUIRE(grandchild->export_to_stream(stream) == 3);
+    std::string line;
+    std::size_t n_lines = 0;
+    while (std::getline(stream, line))
+    {
+        const nl::json record(nl::json::parse(line));
+        REQUIRE(record == expected.at(record["uri"].get<std::string>()));
+        n_lines++;
+    }
+    REQUIRE(n_lines == 3);
+}
+
+TEST_CASE("Test parallel export", "XType")
+{
+    auto registry = std::make_shared<XTypeRegistry>();
+    registry->register_class<Part>();
+    // A binary tree which is larger than a chunk of three threads
+    const std::size_t n_parts = 5000;
+    std::vector< XTypePtr > parts;
+    for (std::size_t i = 0; i < n_parts; ++i)
+    {
+        parts.push_back(registry->instantiate_from(Part::classname));
+        parts.back()->set_property("name", "part" + std::to_string(i));
+        parts.back()->set_all_unknown_facts_empty();
+        if (i > 0)
+            parts[(i - 1) / 2]->add_fact("neighbours", parts.back(), {{"index", i}});
+    }
+
+    INFO("The records and their order are the same as the ones of the sequential export");
+    std::vector< std::pair< std::string, nl::json > > expected;
+    REQUIRE(parts.front()->export_to_writer([&](const std::string& uri, const nl::json& record) { expected.emplace_back(uri, record); }) == n_parts);
+    for (const std::size_t n_threads : {1, 3, 0})
+    {
+        std::vector< std::pair< std::string, nl::json > > written;
+        REQUIRE(parts.front()->export_to_writer_parallel([&](const std::string& uri, const nl::json& record) { written.emplace_back(uri, record); }, n_threads) == n_parts);
+        REQUIRE(written == expected);
+    }
+    std::stringstream sequential, parallel;
+    parts.front()->export_to_stream(sequential);
+    REQUIRE(parts.front()->export_to_stream_parallel(parallel, 3) == n_parts);
+    REQUIRE(parallel.str() == sequential.str());
+
+    INFO("The depth limit is respected");
+    REQUIRE(parts.front()->export_to_writer_parallel([](const std::string&, const nl::json&) {}, 3, 2) == 7);
+}
+
+TEST_CASE("Test streaming bulk import", "XType")
+{
+    auto source = std::make_shared<XTypeRegistry>();
+    source->register_class<UriNode>();
+    XTypePtr root = source->instantiate_from("UriNode");
+    root->set_property("name", "root");
+    root->set_property("comment", "the root");
+    const int n_children = 10;
+    std::vector< XTypePtr > children;
+    for (int i = 0; i < n_children; ++i)
+    {
+        children.push_back(source->instantiate_from("UriNode"));
+        children.back()->set_property("name", "child" + std::to_string(i));
+        children.back()->add_fact("parent", i > 0 ? children[i-1] : root);
+    }
+    std::stringstream dump;
+    REQUIRE(children.back()->export_to_stream(dump) == n_children + 1);
+    const std::string content(dump.str());
+
+    INFO("All records are committed batch by batch");
+    auto target = std::make_shared<XTypeRegistry>();
+    target->register_class<UriNode>();
+    target->set_temporary_policy(TemporaryPolicy::KEEP_NONE);
+    std::vector< ImportStats > reports;
+    std::stringstream input(content);
+    const ImportStats stats(XType::import_from_stream(input, target, 0, [&](const ImportStats& s) { reports.push_back(s); }, 4));
+    REQUIRE(stats.n_imported == n_children + 1);
+    REQUIRE(stats.offset == static_cast<std::streamoff>(content.size()));
+    REQUIRE(reports.size() == 3);
+    REQUIRE(reports[0].n_imported == 4);
+    REQUIRE(stats.nodes_per_second() >= 0.0);
+    XTypePtr imported_root = target->get_by_uri(root->uri());
+    REQUIRE(imported_root);
+    REQUIRE(imported_root->get_property("comment") == "the root");
+    XTypePtr imported_leaf = target->get_by_uri(children.back()->uri());
+    REQUIRE(imported_leaf);
+    // NOTE: With KEEP_NONE we have to hold the fact targets ourselves
+    XTypePtr imported_parent = target->get_by_uri(children[n_children-2]->uri());
+    REQUIRE(imported_leaf->get_facts("parent").at(0).target.lock() == imported_parent);
+
+    INFO("An import can be resumed from the offset of a report");
+    auto resumed = std::make_shared<XTypeRegistry>();
+    resumed->register_class<UriNode>();
+    std::stringstream again(content);
+    const ImportStats rest(XType::import_from_stream(again, resumed, reports[0].offset));
+    REQUIRE(rest.n_imported == n_children + 1 - 4);
+    REQUIRE(rest.offset == stats.offset);
+
+    INFO("Invalid records are reported with their offset");
+    std::stringstream broken(content.substr(0, reports[0].offset) + "{broken\n");
+    REQUIRE_THROWS_AS(XType::import_from_stream(broken, resumed), std::runtime_error);
+}
+
+TEST_CASE("Test parallel bulk import", "XType")
+{
+    auto source = std::make_shared<XTypeRegistry>();
+    source->register_class<Part>();
+    const std::size_t n_parts = 2000;
+    std::vector< XTypePtr > parts;
+    for (std::size_t i = 0; i < n_parts; ++i)
+    {
+        parts.push_back(source->instantiate_from(Part::classname));
+        parts.back()->set_property("name", "part" + std::to_string(i));
+        parts.back()->set_all_unknown_facts_empty();
+        if (i > 0)
+            parts[(i - 1) / 2]->add_fact("neighbours", parts.back());
+    }
+    std::vector< nl::json > records;
+    std::stringstream dump;
+    parts.front()->export_to_writer([&](const std::string&, const nl::json& record) {
+        records.push_back(record);
+        dump << record.dump() << '\n';
+    });
+    records.push_back(nl::json::object());
+
+    INFO("Many records are instantiated concurrently and committed at once");
+    auto target = std::make_shared<XTypeRegistry>();
+    target->register_class<Part>();
+    target->set_temporary_policy(TemporaryPolicy::KEEP_NONE);
+    const ImportStats stats(XType::import_many(records, target, 4));
+    REQUIRE(stats.n_imported == n_parts);
+    REQUIRE(stats.n_skipped == 1);
+    for (std::size_t i = 0; i < n_parts; i += 97)
+    {
+        XTypePtr imported(target->get_by_uri(parts[i]->uri()));
+        REQUIRE(imported);
+        REQUIRE(imported->export_record() == parts[i]->export_record());
+    }
+
+    INFO("Streams are imported by several threads with the same result");
+    auto streamed = std::make_shared<XTypeRegistry>();
+    streamed->register_class<Part>();
+    streamed->set_temporary_policy(TemporaryPolicy::KEEP_NONE);
+    std::size_t n_reports = 0;
+    const ImportStats stream_stats(XType::import_from_stream(dump, streamed, 0, [&](const ImportStats&) { n_reports++; }, 256, 4));
+    REQUIRE(stream_stats.n_imported == n_parts);
+    REQUIRE(stream_stats.offset == static_cast<std::streamoff>(dump.str().size()));
+    REQUIRE(n_reports == 8);
+    REQUIRE(streamed->get_by_uri(parts.back()->uri())->export_record() == parts.back()->export_record());
+
+    INFO("Invalid records are reported and nothing of them is committed");
+    auto failed = std::make_shared<XTypeRegistry>();
+    failed->register_class<Part>();
+    std::vector< nl::json > broken(records.begin(), records.begin() + 10);
+    broken[3]["classname"] = "Unknown";
+    broken[7].erase("uri");
+    REQUIRE_THROWS_WITH(XType::import_many(broken, failed, 4), Catch::Contains("Unknown"));
+    REQUIRE(!failed->knows_uri(parts.front()->uri()));
+}
+
+TEST_CASE("Test binary serialization", "XType")
+{
+    auto source = std::make_shared<XTypeRegistry>();
+    source->register_class<UriNode>();
+    XTypePtr root = source->instantiate_from("UriNode");
+    root->set_property("name", "root");
+    XTypePtr child = source->instantiate_from("UriNode");
+    child->set_property("name", "child");
+    child->set_property("comment", "binary");
+    child->add_fact("parent", root);
+    const std::map< std::string, nl::json > expected(child->export_to());
+
+    INFO("The binary document is smaller than the JSON export");
+    const std::vector< std::uint8_t > data(child->export_binary());
+    std::stringstream json_lines;
+    child->export_to_stream(json_lines);
+    REQUIRE(data.size() < json_lines.str().size());
+
+    INFO("Importing it restores the same records");
+    auto target = std::make_shared<XTypeRegistry>();
+    target->register_class<UriNode>();
+    XTypePtr imported = XType::import_binary(data, target);
+    REQUIRE(imported);
+    REQUIRE(imported->uri() == child->uri());
+    REQUIRE(imported->export_record() == expected.at(child->uri()));
+    XTypePtr imported_root = target->get_by_uri(root->uri());
+    REQUIRE(imported_root->export_record() == expected.at(root->uri()));
+
+    INFO("The registry exports and imports all valid instances");
+    auto copy = std::make_shared<XTypeRegistry>();
+    copy->register_class<UriNode>();
+    REQUIRE(copy->import_binary(target->export_binary()) == 2);
+    REQUIRE(copy->knows_uri(root->uri()));
+    REQUIRE(copy->knows_uri(child->uri()));
+
+    INFO("Other data is rejected");
+    REQUIRE_THROWS_AS(XType::import_binary({0x01, 0x02, 0x03}, target), std::runtime_error);
+    REQUIRE_THROWS_AS(XType::import_binary(nl::json::to_msgpack(nl::json{{"format", "other"}}), target), std::runtime_error);
+}
+
+TEST_CASE("Test memory mapped registry snapshots", "XTypeRegistry")
+{
+    const std::string path("XTypeRegistry_test.snapshot");
+    auto source = std::make_shared<XTypeRegistry>(4);
+    source->register_class<UriNode>();
+    const int n_nodes = 100;
+    std::vector< XTypePtr > nodes;
+    for (int i = 0; i < n_nodes; ++i)
+    {
+        nodes.push_back(source->instantiate_from("UriNode"));
+        nodes.back()->set_property("name", "node" + std::to_string(i));
+        nodes.back()->set_property("comment", "snapshot");
+    }
+    nodes[1]->add_fact("parent", nodes[0]);
+    REQUIRE(source->commit_many(nodes, true) == n_nodes);
+    REQUIRE(source->write_snapshot(path) == n_nodes);
+
+    INFO("Uris are resolved against the snapshot and materialized on first access");
+    auto registry = std::make_shared<XTypeRegistry>();
+    registry->register_class<UriNode>();
+    registry->set_temporary_policy(TemporaryPolicy::KEEP_NONE);
+    registry->open_snapshot(path);
+    REQUIRE(registry->knows_uri("test://node42"));
+    REQUIRE(!registry->knows_uri("test://unknown"));
+    REQUIRE(registry->get_by_uri("test://unknown") == nullptr);
+    REQUIRE(registry->get_temporary_stats().created == 0);
+    XTypePtr node = registry->get_by_uri("test://node42");
+    REQUIRE(node);
+    REQUIRE(node->get_property("comment") == "snapshot");
+    REQUIRE(registry->get_by_uri("test://node42") == node);
+
+    INFO("Facts are resolved through the snapshot as well");
+    XTypePtr child = registry->get_by_uri(nodes[1]->uri());
+    REQUIRE(child);
+    XTypePtr parent = registry->get_by_uri(nodes[0]->uri());
+    REQUIRE(child->get_facts("parent").at(0).target.lock() == parent);
+
+    INFO("Materialized instances stay after closing the snapshot");
+    registry->close_snapshot();
+    REQUIRE(registry->knows_uri("test://node42"));
+    REQUIRE(!registry->knows_uri("test://node43"));
+
+    INFO("Other files are rejected");
+    REQUIRE_THROWS_AS(registry->open_snapshot("does_not_exist.snapshot"), std::runtime_error);
+    {
+        std::ofstream other(path, std::ios::binary | std::ios::trunc);
+        other << std::string(64, 'x');
+    }
+    REQUIRE_THROWS_AS(registry->open_snapshot(path), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Test incremental export of changes", "XTypeRegistry")
+{
+    auto registry = std::make_shared<XTypeRegistry>();
+    registry->register_class<UriNode>();
+    XTypePtr root = registry->instantiate_from("UriNode");
+    root->set_property("name", "root");
+    XTypePtr child = registry->instantiate_from("UriNode");
+    child->set_property("name", "child");
+    child->add_fact("parent", root);
+    XTypePtr other = registry->instantiate_from("UriNode");
+    other->set_property("name", "other");
+
+    std::map< std::string, nl::json > written;
+    const auto writer = [&](const std::string& uri, const nl::json& record) { written[uri] = record; };
+
+    INFO("New xtypes are exported completely and committed");
+    REQUIRE(root->has_changes());
+    REQUIRE(registry->export_changes(writer) == 3);
+    REQUIRE(written.size() == 3);
+    REQUIRE(written.at(child->uri()) == child->export_record());
+    REQUIRE(registry->knows_uri(child->uri()));
+    REQUIRE(!child->has_changes());
+
+    INFO("Without modifications nothing is exported");
+    written.clear();
+    REQUIRE(registry->export_changes(writer) == 0);
+    REQUIRE(written.empty());
+
+    INFO("Only modified xtypes and their changed relations are exported");
+    other->set_property("comment", "changed");
+    REQUIRE(other->has_changes());
+    REQUIRE(other->get_changed_relations().empty());
+    REQUIRE(registry->export_changes(writer) == 1);
+    REQUIRE(written.at(other->uri())["properties"]["comment"] == "changed");
+    REQUIRE(written.at(other->uri())["relations"].empty());
+    REQUIRE(registry->get_by_uri(other->uri())->get_property("comment") == "changed");
+
+    written.clear();
+    other->add_fact("parent", root);
+    other->set_property("comment", "moved");
+    other->set_property("comment", "moved again");
+    REQUIRE(other->get_changed_relations() == std::set< std::string >{"parent"});
+    REQUIRE(registry->export_changes(writer) == 1);
+    const nl::json& record(written.at(other->uri()));
+    REQUIRE(record["relations"]["parent"].size() == 1);
+    REQUIRE(record["relations"]["parent"][0]["target"] == root->uri());
+
+    INFO("Imported xtypes are not reported until they are modified");
+    auto target = std::make_shared<XTypeRegistry>();
+    target->register_class<UriNode>();
+    XTypePtr imported = XType::import_from(written.at(other->uri()), target);
+    REQUIRE(!imported->has_changes());
+    REQUIRE(target->export_changes(writer) == 0);
+    imported->set_property("comment", "local");
+    written.clear();
+    REQUIRE(target->export_changes(writer) == 1);
+    REQUIRE(written.begin()->second["properties"]["comment"] == "local");
+}
+
+TEST_CASE("Test copy-on-write sharing of copies", "XType")
+{
+    auto registry = std::make_shared<XTypeRegistry>();
+    registry->register_class<UriNode>();
+    registry->set_temporary_policy(TemporaryPolicy::KEEP_NONE);
+    auto original = std::static_pointer_cast<UriNode>(registry->instantiate_from("UriNode"));
+    original->set_property("name", "original");
+    auto target = std::static_pointer_cast<UriNode>(registry->instantiate_from("UriNode"));
+    target->set_property("name", "target");
+    original->add_fact("parent", target);
+    const PropertyKey comment("comment");
+    REQUIRE(original->get_property_by_key(comment) == "");
+
+    INFO("Copies share the data until one of them modifies it");
+    UriNode copy(*original);
+    REQUIRE(copy.shares_data_with(*original));
+    REQUIRE(copy.get_property_by_key(comment) == "");
+    copy.set_property_by_key(comment, "copied");
+    REQUIRE(!copy.shares_data_with(*original));
+    REQUIRE(copy.get_property_by_key(comment) == "copied");
+    REQUIRE(original->get_property_by_key(comment) == "");
+    copy.remove_fact("parent", target);
+    REQUIRE(copy.get_facts("parent").empty());
+    REQUIRE(original->get_facts("parent").size() == 1);
+
+    INFO("Reading and re-adding known facts does not copy them");
+    UriNode reader(*original);
+    reader.get_facts("parent");
+    reader.add_fact("parent", target);
+    REQUIRE(reader.shares_data_with(*original));
+
+    INFO("Checked out instances share the data with the valid ones");
+    REQUIRE(registry->commit(original, true));
+    const std::string uri(original->uri());
+    {
+        auto checkout = std::static_pointer_cast<UriNode>(registry->get_by_uri(uri));
+        REQUIRE(checkout != original);
+        REQUIRE(checkout->shares_data_with(*original));
+        checkout->set_property("comment", "not committed");
+        REQUIRE(original->get_property("comment") == "");
+    }
+    REQUIRE(registry->get_by_uri(uri)->get_property("comment") == "");
+}
+
+TEST_CASE("Test instrumentation counters", "Instrumentation")
+{
+    namespace ins = xtypes::instrumentation;
+    ins::reset();
+    auto registry = std::make_shared<XTypeRegistry>();
+    registry->register_class<Assembly>();
+    registry->register_class<Part>();
+    registry->register_class<UriNode>();
+    registry->set_load_func([](const std::string& uri) -> XTypePtr {
+        if (uri == "test://missing")
+            return nullptr;
+        auto node = std::make_shared<UriNode>();
+        node->set_property("name", uri.substr(7));
+        node->set_all_unknown_facts_empty();
+        return node;
+    });
+    XTypePtr assembly(registry->instantiate<Assembly>());
+    XTypePtr part(registry->instantiate<Part>());
+    assembly->set_all_unknown_facts_empty();
+    part->set_all_unknown_facts_empty();
+    part->set_property("name", "part");
+    assembly->add_fact("parts", part);
+    REQUIRE(registry->commit(part, true));
+    REQUIRE(registry->load_by_uri(part->uri()));
+    REQUIRE(registry->load_by_uri("test://loaded"));
+    REQUIRE(!registry->load_by_uri("test://missing"));
+
+    if (!ins::enabled())
+    {
+        INFO("Without XTYPES_INSTRUMENTATION nothing is counted");
+        REQUIRE(ins::count(ins::Counter::COMMITS) == 0);
+        REQUIRE(ins::histogram(ins::Timer::COMMIT).count == 0);
+        REQUIRE(ins::snapshot()["enabled"] == false);
+        return;
+    }
+
+    INFO("The hot paths are counted");
+    REQUIRE(ins::count(ins::Counter::URI_BUILDS) > 0);
+    REQUIRE(ins::count(ins::Counter::URI_CACHE_HITS) > 0);
+    REQUIRE(ins::count(ins::Counter::INVERSE_FILLS) > 0);
+    REQUIRE(ins::count(ins::Counter::INVERSE_FALLBACKS) == 0);
+    REQUIRE(ins::count(ins::Counter::LOAD_HITS) == 1);
+    REQUIRE(ins::count(ins::Counter::LOAD_MISSES) == 2);
+    REQUIRE(ins::count(ins::Counter::LOAD_FAILURES) == 1);
+    REQUIRE(ins::count(ins::Counter::COMMITS) == 2);
+    REQUIRE(ins::count(ins::Counter::COMMIT_COPIES) >= 2);
+    REQUIRE(ins::count(ins::Counter::CHECKOUT_COPIES) >= 1);
+    const ins::Histogram commits(ins::histogram(ins::Timer::COMMIT));
+    REQUIRE(commits.count == 2);
+    REQUIRE(commits.quantile_ns(1.0) >= commits.total_ns / commits.count);
+    REQUIRE(ins::histogram(ins::Timer::LOAD_FUNC).count == 2);
+
+    INFO("The counts of all threads are summed up");
+    std::thread([&registry]() {
+        XTypePtr other(registry->instantiate<Part>());
+        other->set_all_unknown_facts_empty();
+        other->set_property("name", "other");
+        registry->commit(other, true);
+    }).join();
+    REQUIRE(ins::count(ins::Counter::COMMITS) == 3);
+    const nl::json snapshot(ins::snapshot());
+    REQUIRE(snapshot["enabled"] == true);
+    REQUIRE(snapshot["counters"]["COMMITS"] == 3);
+    REQUIRE(snapshot["timers"]["COMMIT"]["count"] == 3);
+
+    ins::reset();
+    REQUIRE(ins::count(ins::Counter::COMMITS) == 0);
+    REQUIRE(ins::histogram(ins::Timer::COMMIT).count == 0);
+}
+
+TEST_CASE("Test tracing spans", "Instrumentation")
+{
+    auto registry = std::make_shared<XTypeRegistry>();
+    registry->register_class<UriNode>();
+    registry->set_load_func([](const std::string& uri) -> XTypePtr {
+        auto node = std::make_shared<UriNode>();
+        node->set_property("name", uri.substr(7));
+        return node;
+    });
+    auto child = std::static_pointer_cast<UriNode>(registry->instantiate_from("UriNode"));
+    child->set_property("name", "child");
+    child->add_unresolved_fact("parent", "test://parent");
+    const nl::json record(child->export_record());
+    const std::string path("xtypes_trace_test.json");
+
+    if (!xtypes::instrumentation::enabled())
+    {
+        INFO("Without XTYPES_INSTRUMENTATION there is nothing to trace");
+        REQUIRE_THROWS(tracing::start(path));
+        REQUIRE(!tracing::is_running());
+        REQUIRE(tracing::stop() == 0);
+        return;
+    }
+
+    INFO("The spans of a resolving get_facts() contain the spans of the loads it caused");
+    tracing::start(path);
+    REQUIRE(tracing::is_running());
+    REQUIRE_THROWS(tracing::start(path));
+    XTypePtr imported(XType::import_from(record, registry));
+    REQUIRE(imported->get_facts("parent").size() == 1);
+    REQUIRE(tracing::stop() > 0);
+    REQUIRE(!tracing::is_running());
+
+    std::ifstream file(path);
+    const nl::json trace(nl::json::parse(file));
+    std::remove(path.c_str());
+    std::map< std::string, nl::json > spans;
+    for (const nl::json& event : trace["traceEvents"])
+    {
+        REQUIRE(event["ph"] == "X");
+        REQUIRE(event["dur"].get<double>() >= 0.0);
+        spans[event["name"]] = event;
+    }
+    REQUIRE(spans.count("XType::import_from"));
+    REQUIRE(spans["XType::import_from"]["args"]["classname"] == "UriNode");
+    REQUIRE(spans.count("XTypeRegistry::commit"));
+    REQUIRE(spans.count("XType::get_facts"));
+    REQUIRE(spans["XType::get_facts"]["args"]["relation"] == "parent");
+    REQUIRE(spans["XType::get_facts"]["args"]["uri"] == child->uri());
+    REQUIRE(spans.count("XTypeRegistry::load_func"));
+    const nl::json& outer(spans["XType::get_facts"]);
+    const nl::json& inner(spans["XTypeRegistry::load_func"]);
+    REQUIRE(inner["args"]["uri"] == "test://parent");
+    REQUIRE(inner["tid"] == outer["tid"]);
+    REQUIRE(inner["ts"].get<double>() >= outer["ts"].get<double>());
+    REQUIRE(inner["ts"].get<double>() + inner["dur"].get<double>() <= outer["ts"].get<double>() + outer["dur"].get<double>());
+
+    INFO("Nothing is recorded after the trace has been stopped");
+    imported->get_facts("parent");
+    REQUIRE(tracing::stop() == 0);
+}
@@ -0,0 +1,307 @@
+/*
+ * Benchmarks of the hot paths of XType and XTypeRegistry on synthetic graphs:
+ *   chain: every node links to the next one
+ *   star:  one hub links to all other nodes
+ *   mesh:  every node links to 16 others
+ *   wide:  a chain of nodes with 256 properties each
+ * The relation "links" has the inverse relation "linked_by", so adding facts auto-fills the inverse ones.
+ * In addition the uuid schemes are compared by their throughput (uri_to_uuid) and the collisions among 1M uris (uuid_collisions).
+ *
+ * Usage: xtypes_bench [--filter=<substring>] [--repetitions=<n>] [--scale=<factor>] [--output=<file>]
+ *   --scale multiplies the number of nodes, --output additionally writes the results as JSON lines
+ */
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "CRC.h"
+#include "utils.hpp"
+#include "XType.hpp"
+#include "XTypeRegistry.hpp"
+
+using namespace xtypes;
+using xtypes_bench::Params;
+using xtypes_bench::Runner;
+
+namespace {
+    /// A node with a few properties and links to other nodes
+    class BenchNode : public XType
+    {
+    public:
+        static inline const std::string classname = "BenchNode";
+
+        BenchNode() : XType(BenchNode::classname)
+        {
+            if (adopt_class_schema(BenchNode::classname))
+                return;
+            define_properties(8);
+            share_class_schema(BenchNode::classname);
+        }
+
+    protected:
+        BenchNode(const std::string& classname) : XType(classname) {}
+
+        void define_properties(const std::size_t n_attributes)
+        {
+            define_property("name", nl::json::value_t::string, {}, "");
+            define_property("weight", nl::json::value_t::number_float, {}, 0.0);
+            for (std::size_t i = 0; i < n_attributes; ++i)
+                define_property("attribute" + std::to_string(i), nl::json::value_t::string, {}, "default value of an attribute");
+            CONNECTED_TO("links", {BenchNode::classname, "WideNode"});
+            CONNECTED_TO("linked_by", {BenchNode::classname, "WideNode"}, {}, true);
+        }
+
+        std::string build_uri() const override
+        {
+            return "bench:/models/" + get_property("name").get<std::string>();
+        }
+        const std::set<std::string>& get_uri_properties() const override
+        {
+            static const std::set<std::string> props{"name"};
+            return props;
+        }
+    };
+
+    /// A node with many properties
+    class WideNode : public BenchNode
+    {
+    public:
+        static inline const std::string classname = "WideNode";
+
+        WideNode() : BenchNode(WideNode::classname)
+        {
+            if (adopt_class_schema(WideNode::classname))
+                return;
+            define_properties(256);
+            share_class_schema(WideNode::classname);
+        }
+    };
+
+    /// The shape of a synthetic graph
+    struct Topology
+    {
+        std::string name;
+        std::string classname;
+        std::size_t n_nodes;
+        std::size_t n_attributes;
+        /// Returns the targets of the links of node i
+        std::function< std::vector< std::size_t >(const std::size_t i, const std::size_t n) > links;
+    };
+
+    /// A synthetic graph in its own registry
+    struct Graph
+    {
+        std::shared_ptr< XTypeRegistry > registry;
+        std::vector< XTypePtr > nodes;
+        std::vector< std::pair< std::size_t, std::size_t > > edges;
+
+        Graph(const Topology& topology, const bool with_links)
+        : registry(std::make_shared< XTypeRegistry >())
+        {
+            registry->register_class< BenchNode >();
+            registry->register_class< WideNode >();
+            registry->set_temporary_policy(TemporaryPolicy::KEEP_NONE);
+            nodes.reserve(topology.n_nodes);
+            for (std::size_t i = 0; i < topology.n_nodes; ++i)
+            {
+                XTypePtr node(registry->instantiate_from(topology.classname));
+                node->set_property("name", topology.name + std::to_string(i));
+                node->set_all_unknown_facts_empty();
+                nodes.push_back(node);
+                for (const std::size_t target : topology.links(i, topology.n_nodes))
+                    edges.emplace_back(i, target);
+            }
+            if (with_links)
+                link();
+        }
+
+        void link()
+        {
+            for (const auto& [source, target] : edges)
+                nodes[source]->add_fact("links", nodes[target]);
+        }
+
+        void commit()
+        {
+            registry->commit_many(nodes, true);
+        }
+    };
+
+    std::vector< Topology > topologies(const Runner& runner)
+    {
+        return {
+            {"chain", BenchNode::classname, runner.scaled(10000), 8, [](const std::size_t i, const std::size_t n) {
+                return (i + 1 < n) ? std::vector< std::size_t >{i + 1} : std::vector< std::size_t >{};
+            }},
+            {"star", BenchNode::classname, runner.scaled(10000), 8, [](const std::size_t i, const std::size_t n) {
+                std::vector< std::size_t > targets;
+                if (i == 0)
+                    for (std::size_t j = 1; j < n; ++j)
+                        targets.push_back(j);
+                return targets;
+            }},
+            {"mesh", BenchNode::classname, runner.scaled(2000), 8, [](const std::size_t i, const std::size_t n) {
+                std::vector< std::size_t > targets;
+                for (std::size_t j = 0; (j < 16) && (j + 1 < n); ++j)
+                    targets.push_back((i + 1 + j * (n / 16 + 1)) % n);
+                std::sort(targets.begin(), targets.end());
+                targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+                targets.erase(std::remove(targets.begin(), targets.end(), i), targets.end());
+                return targets;
+            }},
+            {"wide", WideNode::classname, runner.scaled(1000), 256, [](const std::size_t i, const std::size_t n) {
+                return (i + 1 < n) ? std::vector< std::size_t >{i + 1} : std::vector< std::size_t >{};
+            }},
+        };
+    }
+
+    /// Compares the uuid schemes on uris like the ones of generated classes
+    void uuid_benchmarks(Runner& runner)
+    {
+        if (!runner.selected("uri_to_uuid") && !runner.selected("uri_to_uuid_bytewise") && !runner.selected("uuid_collisions"))
+            return;
+        for (const std::size_t n_segments : {1, 4, 16})
+        {
+            std::vector< std::string > uris;
+            for (std::size_t i = 0; i < runner.scaled(1000000); ++i)
+            {
+                std::string uri("bench:/BenchNode/node" + std::to_string(i));
+                for (std::size_t s = 1; s < n_segments; ++s)
+                    uri += "/" + std::to_string((i * 2654435761U + s) % 100000);
+                uris.push_back(std::move(uri));
+            }
+            std::size_t total_size = 0;
+            for (const std::string& uri : uris)
+                total_size += uri.size();
+            for (const UuidScheme scheme : {UuidScheme::CRC32, UuidScheme::CRC32C, UuidScheme::CRC64})
+            {
+                const Params params{{"scheme", UuidScheme2Str[static_cast< int >(scheme)]}, {"uris", uris.size()}, {"mean_size", total_size / uris.size()}};
+                std::vector< std::uint64_t > uuids(uris.size());
+                // NOTE: The throughput is measured on a working set which fits into the cache, so it is not dominated by memory accesses
+                const std::size_t n_hot = std::min< std::size_t >(uris.size(), 4096);
+                runner.run("uri_to_uuid", params, {}, [&]() {
+                    for (std::size_t r = 0; r < 64; ++r)
+                        for (std::size_t i = 0; i < n_hot; ++i)
+                            uuids[i] = uri_to_uuid(uris[i], scheme);
+                    return 64 * n_hot;
+                });
+                if (scheme == UuidScheme::CRC32)
+                {
+                    // The former byte by byte implementation of the CRC32 scheme as baseline
+                    runner.run("uri_to_uuid_bytewise", params, {}, [&]() {
+                        for (std::size_t r = 0; r < 64; ++r)
+                            for (std::size_t i = 0; i < n_hot; ++i)
+                                uuids[i] = CRC::Calculate(uris[i].data(), uris[i].size(), CRC::CRC_32());
+                        return 64 * n_hot;
+                    });
+                }
+                if (!runner.selected("uuid_collisions"))
+                    continue;
+                for (std::size_t i = 0; i < uris.size(); ++i)
+                    uuids[i] = uri_to_uuid(uris[i], scheme);
+                std::sort(uuids.begin(), uuids.end());
+                std::size_t collisions = 0;
+                for (std::size_t i = 1; i < uuids.size(); ++i)
+                    collisions += (uuids[i] == uuids[i - 1]);
+                // Of n random b bit values about n^2 / 2^(b+1) collide
+                const double bits = (scheme == UuidScheme::CRC64) ? 64.0 : 32.0;
+                runner.report("uuid_collisions", params, {{"collisions", collisions},
+                                                          {"rate", static_cast< double >(collisions) / uris.size()},
+                                                          {"expected_random", std::pow(static_cast< double >(uris.size()), 2.0) / std::pow(2.0, bits + 1.0)}});
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Runner runner(argc, argv);
+    uuid_benchmarks(runner);
+    for (const Topology& topology : topologies(runner))
+    {
+        const Params params{{"topology", topology.name}, {"nodes", topology.n_nodes}};
+        std::unique_ptr< Graph > graph;
+        auto fresh = [&](const bool with_links) { return [&, with_links]() { graph = std::make_unique< Graph >(topology, with_links); }; };
+
+        runner.run("add_fact", params, fresh(false), [&]() {
+            graph->link();
+            return graph->edges.size();
+        });
+
+        runner.run("set_property", params, fresh(true), [&]() {
+            std::size_t n = 0;
+            for (const XTypePtr& node : graph->nodes)
+                for (std::size_t a = 0; a < topology.n_attributes; a += 8, ++n)
+                    node->set_property("attribute" + std::to_string(a), "value " + std::to_string(n));
+            return n;
+        });
+
+        runner.run("get_facts", params, fresh(true), [&]() {
+            std::size_t n = 0;
+            for (const XTypePtr& node : graph->nodes)
+                n += node->get_facts("links").size() + 1;
+            return n;
+        });
+
+        // The targets of the checked out copies have to be resolved by the registry
+        std::vector< XTypePtr > copies;
+        runner.run("get_facts_resolve", params, [&]() {
+            fresh(true)();
+            graph->commit();
+            copies.clear();
+            for (const XTypePtr& node : graph->nodes)
+                copies.push_back(graph->registry->get_by_uri(node->uri()));
+        }, [&]() {
+            std::size_t n = 0;
+            std::vector< Fact > facts;
+            for (const XTypePtr& copy : copies)
+            {
+                facts = copy->get_facts("links");
+                n += facts.size() + 1;
+            }
+            return n;
+        });
+        copies.clear();
+
+        runner.run("commit", params, fresh(true), [&]() {
+            for (XTypePtr& node : graph->nodes)
+                graph->registry->commit(node, true);
+            return graph->nodes.size();
+        });
+
+        std::vector< std::string > uris;
+        runner.run("get_by_uri", params, [&]() {
+            fresh(true)();
+            graph->commit();
+            uris.clear();
+            for (const XTypePtr& node : graph->nodes)
+                uris.push_back(node->uri());
+        }, [&]() {
+            for (const std::string& uri : uris)
+                graph->registry->get_by_uri(uri);
+            return uris.size();
+        });
+
+        runner.run("export_to", params, fresh(true), [&]() {
+            return graph->nodes.front()->export_to().size();
+        });
+
+        std::vector< nl::json > records;
+        runner.run("import_from", params, [&]() {
+            fresh(true)();
+            records.clear();
+            for (const XTypePtr& node : graph->nodes)
+                records.push_back(node->export_record());
+            // Import into an empty registry
+            graph = std::make_unique< Graph >(Topology{topology.name, topology.classname, 0, 0, topology.links}, false);
+        }, [&]() {
+            for (const nl::json& record : records)
+                XType::import_from(record, graph->registry);
+            return records.size();
+        });
+    }
+    return 0;
+}
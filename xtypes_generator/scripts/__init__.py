@@ -1 +1 @@
-from . import copy_files, get_files, get_and_copy_files, create_xtypes_project, registry_generator, types_generator
+from . import copy_files, get_files, get_and_copy_files, create_xtypes_project, registry_generator, types_generator, generate_synthetic_project
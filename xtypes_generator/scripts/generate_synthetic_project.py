@@ -0,0 +1,282 @@
+#!python3
+
+def can_be_used():
+    return True
+
+
+def cant_be_used_msg():
+    return "Unknown error!"
+
+
+INFO = 'Generates synthetic XType templates and instance graphs of arbitrary size for load testing.'
+
+import argparse
+import json
+import os
+import random
+import zlib
+
+import yaml
+
+
+# The property types of the synthetic classes (in this order) with their template defaults
+PropertyTypes = [("STRING", "\"value\""), ("INTEGER", 0), ("FLOAT", 0.0), ("BOOLEAN", False)]
+
+# The relation types of the synthetic classes (in this order) with the delete policy they are defined with (see XType.hpp)
+# NOTE: We only use MANY2MANY relations, so the random facts can never violate a cardinality constraint
+RelationTypes = [("CONNECTED_TO", "DELETENONE"), ("DEPENDS_ON", "DELETESOURCE"), ("ANNOTATES", "DELETENONE")]
+
+
+def crc_table(polynomial):
+    """Returns the lookup table of a reflected CRC"""
+    table = []
+    for i in range(256):
+        crc = i
+        for _ in range(8):
+            crc = (crc >> 1) ^ polynomial if crc & 1 else crc >> 1
+        table.append(crc)
+    return table
+
+
+# The reflected CRCs of the xtypes::UuidScheme values besides CRC32 (see Hashing.hpp) as (table, mask)
+CrcSchemes = {"CRC32C": (crc_table(0x82F63B78), 0xFFFFFFFF), "CRC64": (crc_table(0xC96C5795D7870F42), 0xFFFFFFFFFFFFFFFF)}
+
+
+def uri_to_uuid(uri, scheme="CRC32"):
+    """
+    Same as xtypes::uri_to_uuid() with the given xtypes::UuidScheme
+    :param uri: the URI
+    :param scheme: the name of the UuidScheme
+    :return: the uuid
+    """
+    data = uri.encode("utf-8")
+    if scheme == "CRC32":
+        return zlib.crc32(data)
+    table, mask = CrcSchemes[scheme]
+    crc = mask
+    for byte in data:
+        crc = (crc >> 8) ^ table[(crc ^ byte) & 0xFF]
+    return crc ^ mask
+
+
+def uri_segment(value):
+    """
+    Converts a primitive property value to a segment of an URI like the generated build_uri() does
+    :param value: the property value
+    :return: the segment
+    """
+    return value if isinstance(value, str) else json.dumps(value)
+
+
+class SyntheticClass:
+    """
+    Describes one synthetic XType class.
+    The classes are grouped into inheritance chains of (inheritance_depth + 1) classes. The names of the properties and
+    relations of a class are prefixed by its depth in the chain, so they never collide with the inherited ones.
+    Only the roots of the chains define the 'name' property and the URI. The other classes inherit both.
+    """
+    def __init__(self, index, args, parent):
+        self.index = index
+        self.name = f"Class{index:0{len(str(args.classes - 1))}d}"
+        self.parent = parent
+        depth = 0 if parent is None else parent.depth + 1
+        self.depth = depth
+        prefix = "" if depth == 0 else f"l{depth}_"
+        self.properties = [(f"{prefix}p{j}",) + PropertyTypes[j % len(PropertyTypes)] for j in range(args.properties)]
+        if depth == 0:
+            self.properties.insert(0, ("name", "STRING", "\"unnamed\""))
+        # Relation k targets the relation_targets classes following the (k+1)th next class
+        self.relations = []
+        for k in range(args.relations):
+            rtype, delete_policy = RelationTypes[k % len(RelationTypes)]
+            targets = sorted({(index + k + 1 + t) % args.classes for t in range(args.relation_targets)})
+            self.relations.append((f"{prefix}r{k}", rtype, delete_policy, targets))
+        self.uri_properties = []
+        self.uri_relation = None
+        if depth == 0:
+            # The URI always contains the unique name. FLOAT properties are skipped, because their C++ string representation differs
+            self.uri_properties = ["name"] + [p[0] for p in self.properties[1:] if p[1] != "FLOAT"][:max(args.uri_from - 1, 0)]
+            if args.uri_from_relation and self.relations:
+                self.uri_relation = self.relations[0][0]
+
+    def all_properties(self):
+        """Returns the inherited and the own properties"""
+        return (self.parent.all_properties() if self.parent else []) + self.properties
+
+    def all_relations(self):
+        """Returns the inherited and the own relations"""
+        return (self.parent.all_relations() if self.parent else []) + self.relations
+
+    def root(self):
+        """Returns the class which defines the URI"""
+        return self.parent.root() if self.parent else self
+
+    def template(self, args, classes):
+        """Returns the content of the template yaml of this class"""
+        result = {"name": self.name}
+        if self.parent:
+            result["inherit"] = self.parent.name
+        result["properties"] = {pname: {"type": ptype, "default": pdefault} for pname, ptype, pdefault in self.properties}
+        result["relations"] = {}
+        for rname, rtype, _, targets in self.relations:
+            result["relations"][rname] = {"type": rtype,
+                                          "other_classnames": [classes[t].name for t in targets],
+                                          "inverse": False,
+                                          "properties": {f"w{e}": {"type": "FLOAT", "default": 1.0} for e in range(args.edge_properties)}}
+        if self.depth == 0:
+            uri_from = [{"name": p} for p in self.uri_properties]
+            if self.uri_relation:
+                uri_from.append({"name": self.uri_relation, "required": False})
+            result["uri"] = {"scheme": args.project_name, "root_path": "/" + self.name, "from": uri_from}
+        return result
+
+
+def create_classes(args):
+    """Creates the synthetic classes. Class i inherits class i-1 unless it starts a new inheritance chain"""
+    classes = []
+    for i in range(args.classes):
+        parent = classes[i - 1] if i % (args.inheritance_depth + 1) != 0 else None
+        classes.append(SyntheticClass(i, args, parent))
+    return classes
+
+
+def random_value(rng, ptype):
+    """Returns a random value of the given property type"""
+    if ptype == "STRING":
+        return f"value{rng.randrange(1000000)}"
+    if ptype == "INTEGER":
+        return rng.randrange(-1000000, 1000000)
+    if ptype == "FLOAT":
+        return round(rng.uniform(-1000.0, 1000.0), 3)
+    return rng.random() < 0.5
+
+
+class InstanceGraph:
+    """
+    Generates the instances of the synthetic classes. Instance i is of class (i % classes) and its name is n<i>.
+    For every relation it has fan_out facts to random instances of the target classes.
+    The properties and facts of each instance are drawn from its own seeded random generator, so the records can be
+    written one by one and only the URIs of the instances are held in memory.
+    If the URIs depend on relations, the facts only target instances with a lower index (like a dependency graph),
+    because the URIs of the targets are part of the URI of the source.
+    """
+    def __init__(self, args, classes):
+        self.args = args
+        self.classes = classes
+        self.acyclic = any(c.uri_relation for c in classes)
+        # The URIs of the instances generated so far, or of all instances if they only depend on properties
+        self.uris = []
+        if not self.acyclic:
+            self.uris = [self.uri(i) for i in range(args.instances)]
+
+    def properties(self, i):
+        """Returns the properties of instance i"""
+        rng = random.Random(f"{self.args.seed}:properties:{i}")
+        result = {pname: random_value(rng, ptype) for pname, ptype, _ in self.classes[i % len(self.classes)].all_properties()}
+        result["name"] = f"n{i}"
+        return result
+
+    def uri(self, i, properties=None, relations=None):
+        """Returns the URI of instance i like the generated build_uri() of its root class does"""
+        if i < len(self.uris):
+            return self.uris[i]
+        root = self.classes[i % len(self.classes)].root()
+        if properties is None:
+            properties = self.properties(i)
+        uri = f"{self.args.project_name}:/{root.name}"
+        for p in root.uri_properties:
+            uri += "/" + uri_segment(properties[p])
+        if root.uri_relation:
+            for entry in relations[root.uri_relation]:
+                uri += "/" + str(uri_to_uuid(entry["target"], self.args.uuid_scheme))
+        return uri
+
+    def relations(self, i):
+        """Returns the relations entries of the record of instance i"""
+        rng = random.Random(f"{self.args.seed}:facts:{i}")
+        n_classes = len(self.classes)
+        limit = i if self.acyclic else self.args.instances
+        result = {}
+        for rname, _, delete_policy, targets in self.classes[i % n_classes].all_relations():
+            # The instances of class c are c, c + n_classes, c + 2 * n_classes, ...
+            candidates = [range(t, limit, n_classes) for t in targets]
+            n_candidates = sum(len(c) for c in candidates)
+            entries = []
+            for p in sorted(rng.sample(range(n_candidates), min(self.args.fan_out, n_candidates))):
+                for c in candidates:
+                    if p < len(c):
+                        break
+                    p -= len(c)
+                edge_properties = {f"w{e}": round(rng.uniform(0.0, 1.0), 3) for e in range(self.args.edge_properties)}
+                entries.append({"target": self.uri(c[p]),
+                                "edge_properties": edge_properties if edge_properties else None,
+                                "delete_policy": delete_policy,
+                                "relation_dir_forward": True})
+            result[rname] = entries
+        return result
+
+    def record(self, i):
+        """Returns the record of instance i in the format of XType::export_to()"""
+        properties = self.properties(i)
+        relations = self.relations(i)
+        uri = self.uri(i, properties, relations)
+        if self.acyclic:
+            self.uris.append(uri)
+        return {"properties": properties,
+                "uri": uri,
+                "uuid": str(uri_to_uuid(uri, self.args.uuid_scheme)),
+                "classname": f"{self.args.project_name}::{self.classes[i % len(self.classes)].name}",
+                "relations": relations}
+
+
+def main(args):
+    parser = argparse.ArgumentParser(
+        description='Generates synthetic XType templates and a matching instance graph. '
+                    'The templates can be turned into a project with the usual XTypes CMake macros, '
+                    'the instances can be imported with XType::import_from_stream() (jsonl) or by XType::import_from() (json).')
+    parser.add_argument('-o', '--output', help="The output directory. The templates are written to <output>/templates", type=str, required=True)
+    parser.add_argument('--project_name', help="The project name (namespace and URI scheme of the classes)", type=str, default="synthetic")
+    parser.add_argument('--classes', help="The number of classes", type=int, default=10)
+    parser.add_argument('--properties', help="The number of properties each class defines (in addition to the inherited ones)", type=int, default=8)
+    parser.add_argument('--inheritance_depth', help="The number of times a class is derived from the previous one (0 = no inheritance)", type=int, default=0)
+    parser.add_argument('--relations', help="The number of relations each class defines", type=int, default=2)
+    parser.add_argument('--relation_targets', help="The number of classes each relation can target", type=int, default=1)
+    parser.add_argument('--edge_properties', help="The number of properties of every relation", type=int, default=0)
+    parser.add_argument('--uri_from', help="The number of properties the URIs are built from (at least the name)", type=int, default=1)
+    parser.add_argument('--uri_from_relation', help="Builds the URIs from the first relation as well. The instance graph becomes acyclic then", action="store_true", default=False)
+    parser.add_argument('-n', '--instances', help="The number of instances (0 = only generate the templates)", type=int, default=1000)
+    parser.add_argument('--fan_out', help="The number of facts every instance has per relation", type=int, default=4)
+    parser.add_argument('--format', help="jsonl: one record per line (like XType::export_to_stream()), json: a map from URI to record (like XType::export_to())",
+                        choices=["jsonl", "json"], default="jsonl")
+    parser.add_argument('--uuid_scheme', help="The xtypes::UuidScheme of the uuids. The programs reading the instances have to select the same one with xtypes::set_uuid_scheme()",
+                        choices=["CRC32", "CRC32C", "CRC64"], default="CRC32")
+    parser.add_argument('--seed', help="The seed of the random property values and facts", type=int, default=0)
+    args = parser.parse_args(args)
+
+    if args.classes < 1:
+        raise ValueError("At least one class is needed")
+    if args.inheritance_depth < 0 or args.uri_from < 1:
+        raise ValueError("The inheritance depth must not be negative and the URIs have to be built from at least one property")
+
+    classes = create_classes(args)
+    template_dir = os.path.join(args.output, "templates")
+    os.makedirs(template_dir, exist_ok=True)
+    for cls in classes:
+        with open(os.path.join(template_dir, cls.name + ".yml"), "w") as out_file:
+            yaml.safe_dump(cls.template(args, classes), out_file, sort_keys=False)
+
+    if args.instances < 1:
+        return
+    graph = InstanceGraph(args, classes)
+    with open(os.path.join(args.output, "instances." + args.format), "w") as out_file:
+        if args.format == "jsonl":
+            for i in range(args.instances):
+                out_file.write(json.dumps(graph.record(i)) + "\n")
+        else:
+            json.dump({record["uri"]: record for record in (graph.record(i) for i in range(args.instances))}, out_file)
+    print(f"Generated {len(classes)} templates and {args.instances} instances in {args.output}")
+
+
+if __name__ == "__main__":
+    import sys
+    main(sys.argv[1:])